@@ -12,23 +12,27 @@
 
 /**
  * The threshold which is required to be quarantined,
- * and the message to be printed at the end of it..
+ * and the label of the treatment.
  */
 #define REGULAR_QUARANTINE_THRESHOLD 0.1
-#define REGULAR_QUARANTINE_MSG "Quarantine: %s %lu %lu %lf.\n" // name id age infection_rate
+#define REGULAR_QUARANTINE_LABEL "Quarantine"
 
 /**
  * The threshold which is required to be hospitalized,
- * and the message to be printed at the end of it..
+ * and the label of the treatment.
  */
 #define MEDICAL_SUPERVISION_THRESHOLD  0.3
-#define MEDICAL_SUPERVISION_THRESHOLD_MSG "Hospitalization: %s %lu %lu %lf.\n" // name id age infection_rate
+#define MEDICAL_SUPERVISION_LABEL "Hospitalization"
 
 /**
- * The threshold which is required to be quarantined,
- * and the message to be printed at the end of it..
+ * The label of the treatment of people below all the thresholds.
+ */
+#define CLEAN_LABEL "No-Treatment"
+
+/**
+ * The message of any treatment (of a runtime policy, see SpreaderPolicy.h).
  */
-#define CLEAN_MSG "No-Treatment: %s %lu %lu %lf.\n" // name id age infection_rate
+#define TREATMENT_MSG "%s: %s %lu %lu %lf.\n" // treatment name id age infection_rate
 
 /**
  * Age threshold.
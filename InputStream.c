@@ -0,0 +1,398 @@
+#include "InputStream.h"
+#include <stdbool.h>
+
+#ifdef SPREADER_DETECTOR_ZLIB
+#include <zlib.h>
+#endif
+#ifdef SPREADER_DETECTOR_ZSTD
+#include <zstd.h>
+#endif
+#include "SpreaderAlloc.h"
+
+/**
+ * @def INPUT_STREAM_RAW_SIZE
+ * the size (in bytes) of the compressed chunks read from the file.
+ */
+#define INPUT_STREAM_RAW_SIZE (64UL * 1024UL)
+
+InputStreamFormat InputStreamDetectFormat(FILE *file);
+int InputStreamDecoderAlloc(InputStream *stream);
+void InputStreamDecoderFree(InputStream *stream);
+int InputStreamFill(InputStream *stream, InputStreamBlock *block);
+void *InputStreamDecompress(void *arg);
+InputStreamBlock *InputStreamCurrentBlock(InputStream *stream);
+
+
+#ifdef SPREADER_DETECTOR_ZLIB
+/**
+ * @struct GzipDecoder
+ * The state of the gzip decompression.
+ * @param zs the zlib stream.
+ * @param in the compressed chunk which is being inflated.
+ * @param member_end 1 if the last inflate call finished a gzip member.
+ */
+typedef struct GzipDecoder {
+  z_stream zs;
+  unsigned char in[INPUT_STREAM_RAW_SIZE];
+  int member_end;
+} GzipDecoder;
+#endif
+
+#ifdef SPREADER_DETECTOR_ZSTD
+/**
+ * @struct ZstdDecoder
+ * The state of the zstd decompression.
+ * @param ctx the zstd decompression context.
+ * @param in the compressed chunk which is being decompressed.
+ * @param input the position inside the compressed chunk.
+ * @param frame_end 1 if the last call finished a zstd frame.
+ */
+typedef struct ZstdDecoder {
+  ZSTD_DCtx *ctx;
+  unsigned char in[INPUT_STREAM_RAW_SIZE];
+  ZSTD_inBuffer input;
+  int frame_end;
+} ZstdDecoder;
+#endif
+
+
+/**
+ * Opens the file in the given path, detects its format and starts
+ * the decompression thread.
+ * @param path the path to the file.
+ * @return pointer to dynamically allocated InputStream.
+ * @if_fails returns NULL (including a compressed file whose format
+ * support was not compiled in).
+ * @assumption you can not assume anything.
+ */
+InputStream *InputStreamOpen(const char *path){
+    if (!path){
+        return NULL;
+    }
+    InputStream *stream = calloc(1, sizeof(InputStream));
+    if (!stream){
+        return NULL;
+    }
+    stream->file = fopen(path, "rb");
+    if (!stream->file){
+        free(stream);
+        return NULL;
+    }
+    stream->format = InputStreamDetectFormat(stream->file);
+    stream->blocks = malloc(INPUT_STREAM_NUM_OF_BLOCKS * sizeof(InputStreamBlock));
+    if (!stream->blocks || !InputStreamDecoderAlloc(stream)){
+        free(stream->blocks);
+        fclose(stream->file);
+        free(stream);
+        return NULL;
+    }
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->not_empty, NULL);
+    pthread_cond_init(&stream->not_full, NULL);
+    if (pthread_create(&stream->thread, NULL, InputStreamDecompress, stream) != 0){
+        pthread_mutex_destroy(&stream->lock);
+        pthread_cond_destroy(&stream->not_empty);
+        pthread_cond_destroy(&stream->not_full);
+        InputStreamDecoderFree(stream);
+        free(stream->blocks);
+        fclose(stream->file);
+        free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+/**
+ * This function reads the magic bytes at the beginning of the file and
+ * rewinds it.
+ * @param file the file to detect
+ * @return the format of the file
+ */
+InputStreamFormat InputStreamDetectFormat(FILE *file){
+    unsigned char magic[4] = {0};
+    size_t n = fread(magic, 1, sizeof(magic), file);
+    rewind(file);
+    if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b){
+        return INPUT_STREAM_GZIP;
+    }
+    if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd){
+        return INPUT_STREAM_ZSTD;
+    }
+    return INPUT_STREAM_PLAIN;
+}
+
+/**
+ * This function allocates the decompression state matching the stream format
+ * @param stream the stream
+ * @return true on success, false if the format is not supported or allocation failed
+ */
+int InputStreamDecoderAlloc(InputStream *stream){
+    switch (stream->format) {
+        case INPUT_STREAM_PLAIN:
+            return true;
+        case INPUT_STREAM_GZIP: {
+#ifdef SPREADER_DETECTOR_ZLIB
+            GzipDecoder *decoder = calloc(1, sizeof(GzipDecoder));
+            if (!decoder) return false;
+            // 15 + 32 - the maximal window, with automatic gzip header detection
+            if (inflateInit2(&decoder->zs, 15 + 32) != Z_OK){
+                free(decoder);
+                return false;
+            }
+            stream->decoder = decoder;
+            return true;
+#else
+            return false;
+#endif
+        }
+        case INPUT_STREAM_ZSTD: {
+#ifdef SPREADER_DETECTOR_ZSTD
+            ZstdDecoder *decoder = calloc(1, sizeof(ZstdDecoder));
+            if (!decoder) return false;
+            decoder->ctx = ZSTD_createDCtx();
+            if (!decoder->ctx){
+                free(decoder);
+                return false;
+            }
+            decoder->input.src = decoder->in;
+            stream->decoder = decoder;
+            return true;
+#else
+            return false;
+#endif
+        }
+    }
+    return false;
+}
+
+/**
+ * This function frees the decompression state of the stream
+ * @param stream the stream
+ */
+void InputStreamDecoderFree(InputStream *stream){
+    if (!stream->decoder){
+        return;
+    }
+#ifdef SPREADER_DETECTOR_ZLIB
+    if (stream->format == INPUT_STREAM_GZIP){
+        inflateEnd(&((GzipDecoder *) stream->decoder)->zs);
+    }
+#endif
+#ifdef SPREADER_DETECTOR_ZSTD
+    if (stream->format == INPUT_STREAM_ZSTD){
+        ZSTD_freeDCtx(((ZstdDecoder *) stream->decoder)->ctx);
+    }
+#endif
+    free(stream->decoder);
+    stream->decoder = NULL;
+}
+
+/**
+ * This function fills the given block with the next decompressed bytes of the file.
+ * A block of size 0 marks the end of the file.
+ * @param stream the stream
+ * @param block the block to fill
+ * @return true on success, false on a read or decompression error
+ */
+int InputStreamFill(InputStream *stream, InputStreamBlock *block){
+    block->size = 0;
+    if (stream->format == INPUT_STREAM_PLAIN){
+        block->size = fread(block->data, 1, INPUT_STREAM_BLOCK_SIZE, stream->file);
+        return !ferror(stream->file);
+    }
+#ifdef SPREADER_DETECTOR_ZLIB
+    if (stream->format == INPUT_STREAM_GZIP){
+        GzipDecoder *decoder = stream->decoder;
+        decoder->zs.next_out = (unsigned char *) block->data;
+        decoder->zs.avail_out = INPUT_STREAM_BLOCK_SIZE;
+        while (decoder->zs.avail_out > 0) {
+            if (decoder->zs.avail_in == 0){
+                decoder->zs.avail_in = fread(decoder->in, 1, INPUT_STREAM_RAW_SIZE, stream->file);
+                decoder->zs.next_in = decoder->in;
+                if (decoder->zs.avail_in == 0){
+                    // a truncated member is an error, a finished one is the end of the file
+                    if (ferror(stream->file) || !decoder->member_end) return false;
+                    break;
+                }
+            }
+            if (decoder->member_end){
+                // concatenated gzip members (like "cat a.gz b.gz")
+                if (inflateReset(&decoder->zs) != Z_OK) return false;
+                decoder->member_end = false;
+            }
+            int res = inflate(&decoder->zs, Z_NO_FLUSH);
+            if (res == Z_STREAM_END){
+                decoder->member_end = true;
+            }
+            else if (res != Z_OK){
+                return false;
+            }
+        }
+        block->size = INPUT_STREAM_BLOCK_SIZE - decoder->zs.avail_out;
+        return true;
+    }
+#endif
+#ifdef SPREADER_DETECTOR_ZSTD
+    if (stream->format == INPUT_STREAM_ZSTD){
+        ZstdDecoder *decoder = stream->decoder;
+        ZSTD_outBuffer output = {block->data, INPUT_STREAM_BLOCK_SIZE, 0};
+        while (output.pos < output.size) {
+            if (decoder->input.pos == decoder->input.size){
+                decoder->input.size = fread(decoder->in, 1, INPUT_STREAM_RAW_SIZE, stream->file);
+                decoder->input.pos = 0;
+                if (decoder->input.size == 0){
+                    if (ferror(stream->file) || !decoder->frame_end) return false;
+                    break;
+                }
+            }
+            size_t res = ZSTD_decompressStream(decoder->ctx, &output, &decoder->input);
+            if (ZSTD_isError(res)) return false;
+            decoder->frame_end = (res == 0);
+        }
+        block->size = output.pos;
+        return true;
+    }
+#endif
+    return false;
+}
+
+/**
+ * The decompression thread - fills the ring of blocks ahead of the parser
+ * until the end of the file, an error, or the stream is closed.
+ * @param arg the stream (InputStream *)
+ * @return NULL
+ */
+void *InputStreamDecompress(void *arg){
+    InputStream *stream = arg;
+    pthread_mutex_lock(&stream->lock);
+    while (!stream->stop) {
+        while (stream->filled == INPUT_STREAM_NUM_OF_BLOCKS && !stream->stop) {
+            pthread_cond_wait(&stream->not_full, &stream->lock);
+        }
+        if (stream->stop) break;
+
+        // the tail block is not visible to the parser, so it is filled without the lock
+        InputStreamBlock *block = &stream->blocks[stream->tail];
+        pthread_mutex_unlock(&stream->lock);
+        int success = InputStreamFill(stream, block);
+        pthread_mutex_lock(&stream->lock);
+
+        if (!success || block->size == 0){
+            stream->error = !success;
+            stream->eof = true;
+            pthread_cond_signal(&stream->not_empty);
+            break;
+        }
+        stream->tail = (stream->tail + 1) % INPUT_STREAM_NUM_OF_BLOCKS;
+        stream->filled++;
+        pthread_cond_signal(&stream->not_empty);
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+/**
+ * This function returns the block the parser should read from, releasing the
+ * previous block back to the decompression thread once it was fully read.
+ * @param stream the stream
+ * @return the block to read from, NULL at the end of the stream
+ */
+InputStreamBlock *InputStreamCurrentBlock(InputStream *stream){
+    if (stream->holding && stream->offset < stream->blocks[stream->head].size){
+        return &stream->blocks[stream->head];
+    }
+    pthread_mutex_lock(&stream->lock);
+    if (stream->holding){
+        stream->head = (stream->head + 1) % INPUT_STREAM_NUM_OF_BLOCKS;
+        stream->filled--;
+        stream->offset = 0;
+        stream->holding = false;
+        pthread_cond_signal(&stream->not_full);
+    }
+    while (stream->filled == 0 && !stream->eof) {
+        pthread_cond_wait(&stream->not_empty, &stream->lock);
+    }
+    stream->holding = stream->filled > 0;
+    pthread_mutex_unlock(&stream->lock);
+    return stream->holding ? &stream->blocks[stream->head] : NULL;
+}
+
+/**
+ * Reads the next line of the stream, exactly like fgets does.
+ * @param stream the stream to read from.
+ * @param buffer the buffer to read into.
+ * @param size the size of the buffer (including the '\0').
+ * @return buffer on success, NULL at the end of the stream or on error.
+ * @assumption you can not assume anything.
+ */
+char *InputStreamGetLine(InputStream *stream, char *buffer, size_t size){
+    if (!stream || !buffer || size < 2){
+        return NULL;
+    }
+    size_t len = 0;
+    while (len < size - 1) {
+        InputStreamBlock *block = InputStreamCurrentBlock(stream);
+        if (!block) break;
+
+        const char *start = block->data + stream->offset;
+        size_t n = block->size - stream->offset;
+        if (n > size - 1 - len){
+            n = size - 1 - len;
+        }
+        const char *new_line = memchr(start, '\n', n);
+        if (new_line){
+            n = (size_t) (new_line - start) + 1;
+        }
+        memcpy(buffer + len, start, n);
+        stream->offset += n;
+        len += n;
+        if (new_line) break;
+    }
+    if (len == 0){
+        return NULL;
+    }
+    buffer[len] = '\0';
+    return buffer;
+}
+
+/**
+ * Returns 1 if the stream stopped because of a decompression error.
+ * @param stream the stream.
+ * @return 1 on error, 0 otherwise.
+ * @assumption you can not assume anything.
+ */
+int InputStreamHasError(InputStream *stream){
+    if (!stream){
+        return true;
+    }
+    pthread_mutex_lock(&stream->lock);
+    int error = stream->error;
+    pthread_mutex_unlock(&stream->lock);
+    return error;
+}
+
+/**
+ * Stops the decompression thread, closes the file and frees the stream.
+ * @param p_stream pointer to dynamically allocated stream.
+ * @assumption you can not assume anything.
+ */
+void InputStreamClose(InputStream **p_stream){
+    if (!p_stream || !(*p_stream)){
+        return;
+    }
+    InputStream *stream = *p_stream;
+    pthread_mutex_lock(&stream->lock);
+    stream->stop = true;
+    pthread_cond_broadcast(&stream->not_full);
+    pthread_mutex_unlock(&stream->lock);
+    pthread_join(stream->thread, NULL);
+
+    pthread_mutex_destroy(&stream->lock);
+    pthread_cond_destroy(&stream->not_empty);
+    pthread_cond_destroy(&stream->not_full);
+    InputStreamDecoderFree(stream);
+    free(stream->blocks);
+    fclose(stream->file);
+    free(stream);
+    *p_stream = NULL;
+}
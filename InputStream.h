@@ -0,0 +1,126 @@
+#ifndef INPUTSTREAM_H
+#define INPUTSTREAM_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+/**
+ * ======================= compression ========================
+ * The input files may be stored compressed. The format is detected
+ * by the magic bytes at the beginning of the file:
+ * - gzip (1f 8b) requires compiling with -DSPREADER_DETECTOR_ZLIB (and -lz).
+ * - zstd (28 b5 2f fd) requires compiling with -DSPREADER_DETECTOR_ZSTD (and -lzstd).
+ * Any other file is read as plain text.
+ * The stream always requires -pthread.
+ * ============================================================
+ */
+
+/**
+ * @def INPUT_STREAM_BLOCK_SIZE
+ * the size (in bytes) of each decompressed block.
+ */
+#define INPUT_STREAM_BLOCK_SIZE (64UL * 1024UL)
+
+/**
+ * @def INPUT_STREAM_NUM_OF_BLOCKS
+ * the number of decompressed blocks the decompression thread
+ * may produce ahead of the parser.
+ */
+#define INPUT_STREAM_NUM_OF_BLOCKS 4UL
+
+/**
+ * @enum InputStreamFormat
+ * The format of the file behind the stream.
+ */
+typedef enum InputStreamFormat {
+  INPUT_STREAM_PLAIN,
+  INPUT_STREAM_GZIP,
+  INPUT_STREAM_ZSTD
+} InputStreamFormat;
+
+/**
+ * @struct InputStreamBlock
+ * A block of decompressed data.
+ * @param data the decompressed bytes.
+ * @param size the number of valid bytes in data.
+ */
+typedef struct InputStreamBlock {
+  char data[INPUT_STREAM_BLOCK_SIZE];
+  size_t size;
+} InputStreamBlock;
+
+/**
+ * @struct InputStream
+ * A line reader over a (possibly compressed) file. A dedicated thread
+ * decompresses the file into a ring of blocks ahead of the parser.
+ * @param file the underlying file.
+ * @param format the detected format of the file.
+ * @param decoder the decompression state (owned by the decompression thread).
+ * @param blocks the ring of decompressed blocks.
+ * @param head the index of the block the parser reads from.
+ * @param tail the index of the next block the decompression thread fills.
+ * @param filled the number of blocks ready for the parser.
+ * @param offset the read position inside blocks[head].
+ * @param holding 1 if the parser currently reads from blocks[head].
+ * @param eof 1 if the decompression thread reached the end of the file.
+ * @param error 1 if the decompression failed.
+ * @param stop 1 if the stream is being closed.
+ */
+typedef struct InputStream {
+  FILE *file;
+  InputStreamFormat format;
+  void *decoder;
+  InputStreamBlock *blocks;
+  size_t head;
+  size_t tail;
+  size_t filled;
+  size_t offset;
+  int holding;
+  int eof;
+  int error;
+  int stop;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+} InputStream;
+
+/**
+ * Opens the file in the given path, detects its format and starts
+ * the decompression thread.
+ * @param path the path to the file.
+ * @return pointer to dynamically allocated InputStream.
+ * @if_fails returns NULL (including a compressed file whose format
+ * support was not compiled in).
+ * @assumption you can not assume anything.
+ */
+InputStream *InputStreamOpen(const char *path);
+
+/**
+ * Reads the next line of the stream, exactly like fgets does.
+ * @param stream the stream to read from.
+ * @param buffer the buffer to read into.
+ * @param size the size of the buffer (including the '\0').
+ * @return buffer on success, NULL at the end of the stream or on error.
+ * @assumption you can not assume anything.
+ */
+char *InputStreamGetLine(InputStream *stream, char *buffer, size_t size);
+
+/**
+ * Returns 1 if the stream stopped because of a decompression error.
+ * @param stream the stream.
+ * @return 1 on error, 0 otherwise.
+ * @assumption you can not assume anything.
+ */
+int InputStreamHasError(InputStream *stream);
+
+/**
+ * Stops the decompression thread, closes the file and frees the stream.
+ * @param p_stream pointer to dynamically allocated stream.
+ * @assumption you can not assume anything.
+ */
+void InputStreamClose(InputStream **p_stream);
+
+#endif //INPUTSTREAM_H
@@ -4,6 +4,7 @@
 
 #include "Meeting.h"
 #include <stdbool.h>
+#include "SpreaderAlloc.h"
 
 /**
  * Allocating (dynamically) new meeting with (at least) the following
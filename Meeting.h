@@ -23,12 +23,15 @@ typedef struct Person Person;
  * @param person_2 the second person in the meeting.
  * @param measure the time of the meeting (in minutes).
  * @param distance the distance they were in (in distance).
+ * @param index the index of the meeting in the meetings array of the
+ * spreader detector which holds it.
  */
 typedef struct Meeting {
   Person *person_1;
   Person *person_2;
   double measure;
   double distance;
+  size_t index;
 } Meeting ;
 
 /**
@@ -0,0 +1,462 @@
+#include "MeetingLine.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <float.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @def SWAR_DIGITS
+ * the SWAR conversion reads the digits as a little endian 64 bit word.
+ */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SWAR_DIGITS 1
+#else
+#define SWAR_DIGITS 0
+#endif
+
+/**
+ * @def CLINGER_FAST_PATH
+ * the fast path needs the double operations to be rounded to double (not to a wider type).
+ */
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define CLINGER_FAST_PATH 1
+#else
+#define CLINGER_FAST_PATH 0
+#endif
+
+/**
+ * @def SWAR_WORD_SIZE
+ * the number of digits in a SWAR word.
+ */
+#define SWAR_WORD_SIZE 8
+
+/**
+ * @def SWAR_ZEROS
+ * '0' in each byte of a word.
+ */
+#define SWAR_ZEROS 0x3030303030303030ULL
+
+/**
+ * @def SWAR_DOTS
+ * '.' in each byte of a word.
+ */
+#define SWAR_DOTS 0x2E2E2E2E2E2E2E2EULL
+
+/**
+ * @def MAX_EXACT_MANTISSA
+ * the largest integer up to which every integer is an exact double (2^53).
+ */
+#define MAX_EXACT_MANTISSA 9007199254740992ULL
+
+/**
+ * @def MAX_EXPONENT_DIGITS
+ * the exponents with more digits go to strtod (they are far outside the fast path anyway).
+ */
+#define MAX_EXPONENT_DIGITS 4
+
+static const double g_powers_of_10[MEETING_LINE_MAX_FAST_EXPONENT + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static const uint64_t g_integer_powers_of_10[MEETING_LINE_MAX_ID_DIGITS + 1] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL};
+
+uint64_t FindFieldEnds(const char *line, size_t capacity, size_t *scanned);
+size_t FindFieldEnd(const char *line, size_t capacity, size_t position);
+int IsSeparator(char c);
+int IsFieldEnd(char c);
+int IsDigit(char c);
+size_t CountDigits(const char *digits, size_t length);
+int ParseId(const char *field, size_t length, size_t available, IdT *id);
+int ParseDigits(const char *digits, size_t length, size_t available, uint64_t *value);
+int IsEightDigits(uint64_t word);
+uint64_t ConvertEightDigits(uint64_t word);
+int ParseDecimal(const char *field, size_t length, size_t available, double *value);
+int ParseShortDecimal(const char *field, size_t length, double *value);
+int ParseDecimalWithStrtod(const char *field, size_t length, double *value);
+
+
+/**
+ * Parses a meetings line.
+ * @param line the line ('\0' terminated).
+ * @param capacity the size of the buffer holding the line - the parser may read (but does not use)
+ * the bytes after the '\0', up to capacity; pass strlen(line) + 1 if they are not readable.
+ * @param meeting_line output - the fields of the line.
+ * @return 1 if the line was parsed successfully, 0 if it is malformed.
+ * @if_fails returns 0 (meeting_line is then undefined).
+ * @assumption you can not assume anything.
+ */
+int MeetingLineParse(const char *line, size_t capacity, MeetingLine *meeting_line){
+    if (!line || !meeting_line || capacity == 0){
+        return 0;
+    }
+    size_t starts[4], lengths[4];
+    size_t position = 0, scanned;
+    // the ends of the fields of a typical line are all found by a single scan
+    uint64_t ends = FindFieldEnds(line, capacity, &scanned);
+    for (size_t i = 0; i < 4; ++i) {
+        while (IsSeparator(line[position])) {
+            ++position;
+        }
+        uint64_t next_ends = position < scanned ? ends >> position : 0;
+        size_t end = next_ends ? position + (size_t) __builtin_ctzll(next_ends) :
+                     FindFieldEnd(line, capacity, position > scanned ? position : scanned);
+        if (end == position || end >= capacity){
+            return 0;
+        }
+        starts[i] = position;
+        lengths[i] = end - position;
+        position = end;
+    }
+    // only blanks and the end of the line may follow the fourth field
+    while (IsSeparator(line[position]) || line[position] == '\r' || line[position] == '\n') {
+        ++position;
+    }
+    if (line[position] != '\0'){
+        return 0;
+    }
+    return ParseId(line + starts[0], lengths[0], capacity - starts[0], &meeting_line->id_1) &&
+           ParseId(line + starts[1], lengths[1], capacity - starts[1], &meeting_line->id_2) &&
+           ParseDecimal(line + starts[2], lengths[2], capacity - starts[2], &meeting_line->distance) &&
+           ParseDecimal(line + starts[3], lengths[3], capacity - starts[3], &meeting_line->measure);
+}
+
+/**
+ * This function marks the bytes which end a field (separators, '\r', '\n' and '\0') in the first
+ * 64 bytes of the line, 16 at a time with SSE2 (stops after the block of the '\0')
+ * @param line the line
+ * @param capacity the size of the buffer holding the line
+ * @param scanned output - the number of bytes the mask covers
+ * @return the mask (bit i - byte i)
+ */
+uint64_t FindFieldEnds(const char *line, size_t capacity, size_t *scanned){
+    uint64_t ends = 0;
+    size_t position = 0;
+#ifdef __SSE2__
+    const __m128i spaces = _mm_set1_epi8(' '), tabs = _mm_set1_epi8('\t'), returns = _mm_set1_epi8('\r');
+    const __m128i newlines = _mm_set1_epi8('\n'), zeros = _mm_setzero_si128();
+    while (position + sizeof(__m128i) <= capacity && position < 64) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *) (line + position));
+        __m128i terminators = _mm_cmpeq_epi8(bytes, zeros);
+        __m128i block = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, spaces), _mm_cmpeq_epi8(bytes, tabs)),
+                                     _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, returns),
+                                                               _mm_cmpeq_epi8(bytes, newlines)), terminators));
+        ends |= (uint64_t) (unsigned) _mm_movemask_epi8(block) << position;
+        position += sizeof(__m128i);
+        if (_mm_movemask_epi8(terminators)){
+            break;
+        }
+    }
+#else
+    (void) line;
+    (void) capacity;
+#endif
+    *scanned = position;
+    return ends;
+}
+
+/**
+ * This function finds the end of the field which starts at the given position -
+ * the first separator, '\r', '\n' or '\0' (16 bytes at a time with SSE2)
+ * @param line the line
+ * @param capacity the size of the buffer holding the line
+ * @param position the start of the field
+ * @return the position of the end of the field (capacity if the line is not terminated)
+ */
+size_t FindFieldEnd(const char *line, size_t capacity, size_t position){
+#ifdef __SSE2__
+    const __m128i spaces = _mm_set1_epi8(' '), tabs = _mm_set1_epi8('\t'), returns = _mm_set1_epi8('\r');
+    const __m128i newlines = _mm_set1_epi8('\n'), zeros = _mm_setzero_si128();
+    while (position + sizeof(__m128i) <= capacity) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *) (line + position));
+        __m128i ends = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, spaces), _mm_cmpeq_epi8(bytes, tabs)),
+                                    _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, returns),
+                                                              _mm_cmpeq_epi8(bytes, newlines)),
+                                                 _mm_cmpeq_epi8(bytes, zeros)));
+        unsigned mask = (unsigned) _mm_movemask_epi8(ends);
+        if (mask){
+            return position + (size_t) __builtin_ctz(mask);
+        }
+        position += sizeof(__m128i);
+    }
+#endif
+    while (position < capacity && !IsFieldEnd(line[position])) {
+        ++position;
+    }
+    return position;
+}
+
+/**
+ * This function checks if a character separates the fields
+ * @param c the character
+ * @return 1 for a space or a tab, 0 otherwise
+ */
+int IsSeparator(char c){
+    return c == ' ' || c == '\t';
+}
+
+/**
+ * This function checks if a character ends a field
+ * @param c the character
+ * @return 1 for a separator, '\r', '\n' or '\0', 0 otherwise
+ */
+int IsFieldEnd(char c){
+    return IsSeparator(c) || c == '\r' || c == '\n' || c == '\0';
+}
+
+/**
+ * This function checks if a character is a decimal digit (in any locale)
+ * @param c the character
+ * @return 1 for '0' to '9', 0 otherwise
+ */
+int IsDigit(char c){
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * This function counts the digits at the beginning of the given characters
+ * @param digits the characters
+ * @param length the number of characters
+ * @return the number of leading digits
+ */
+size_t CountDigits(const char *digits, size_t length){
+    size_t count = 0;
+    while (count < length && IsDigit(digits[count])) {
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * This function parses an id - an optional '+' and decimal digits
+ * @param field the field
+ * @param length the length of the field
+ * @param available the number of readable bytes from the field on
+ * @param id output - the id
+ * @return 1 on success, 0 if the field is not an id (or does not fit in IdT)
+ */
+int ParseId(const char *field, size_t length, size_t available, IdT *id){
+    if (field[0] == '+'){
+        ++field;
+        --length;
+        --available;
+    }
+    if (length == 0){
+        return 0;
+    }
+    uint64_t value;
+    if (length <= MEETING_LINE_MAX_ID_DIGITS){
+        if (!ParseDigits(field, length, available, &value)) return 0;
+    }
+    else {
+        value = 0;
+        for (size_t i = 0; i < length; ++i) {
+            if (!IsDigit(field[i])) return 0;
+            uint64_t digit = (uint64_t) (field[i] - '0');
+            if (value > (UINT64_MAX - digit)/10) return 0;
+            value = value*10 + digit;
+        }
+    }
+    if (value > SIZE_MAX){
+        return 0;
+    }
+    *id = (IdT) value;
+    return 1;
+}
+
+/**
+ * This function converts up to MEETING_LINE_MAX_ID_DIGITS decimal digits, 8 at a time
+ * (a single 64 bit load, check and multiply-shift per 8 digits)
+ * @param digits the digits
+ * @param length the number of digits (at most MEETING_LINE_MAX_ID_DIGITS)
+ * @param available the number of readable bytes from the digits on
+ * @param value output - the value
+ * @return 1 on success, 0 if a character is not a digit
+ */
+int ParseDigits(const char *digits, size_t length, size_t available, uint64_t *value){
+    uint64_t result = 0;
+    while (length > 0) {
+        size_t chunk = length < SWAR_WORD_SIZE ? length : SWAR_WORD_SIZE;
+        uint64_t chunk_value = 0;
+        if (SWAR_DIGITS && available >= SWAR_WORD_SIZE){
+            uint64_t word;
+            memcpy(&word, digits, SWAR_WORD_SIZE);
+            if (chunk < SWAR_WORD_SIZE){
+                // the first digit is the lowest byte - move the digits up and fill the low bytes with '0'
+                word = (word << (8*(SWAR_WORD_SIZE - chunk))) | (SWAR_ZEROS >> (8*chunk));
+            }
+            if (!IsEightDigits(word)) return 0;
+            chunk_value = ConvertEightDigits(word);
+        }
+        else {
+            for (size_t i = 0; i < chunk; ++i) {
+                if (!IsDigit(digits[i])) return 0;
+                chunk_value = chunk_value*10 + (uint64_t) (digits[i] - '0');
+            }
+        }
+        result = result*g_integer_powers_of_10[chunk] + chunk_value;
+        digits += chunk;
+        available -= chunk;
+        length -= chunk;
+    }
+    *value = result;
+    return 1;
+}
+
+/**
+ * This function checks if all the bytes of a word are decimal digits
+ * @param word the word
+ * @return 1 if they are, 0 otherwise
+ */
+int IsEightDigits(uint64_t word){
+    // a digit is 0x30-0x39: its high nibble is 3, and adding 6 does not carry into it
+    return (((word & 0xF0F0F0F0F0F0F0F0ULL) |
+             (((word + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL);
+}
+
+/**
+ * This function converts a word of 8 digits (the first digit in the lowest byte)
+ * @param word the word
+ * @return the value of the digits
+ */
+uint64_t ConvertEightDigits(uint64_t word){
+    const uint64_t mask = 0x000000FF000000FFULL;
+    const uint64_t mul_1 = 100 + (1000000ULL << 32);
+    const uint64_t mul_2 = 1 + (10000ULL << 32);
+    word -= SWAR_ZEROS;
+    word = word*10 + (word >> 8); // pairs of digits
+    return (((word & mask)*mul_1 + ((word >> 16) & mask)*mul_2) >> 32) & 0xFFFFFFFFULL;
+}
+
+/**
+ * This function parses a decimal - [sign] digits [. digits] [e [sign] digits] - exactly as strtod
+ * (through the fast path when its value is a single correctly rounded operation, or strtod)
+ * @param field the field
+ * @param length the length of the field
+ * @param available the number of readable bytes from the field on
+ * @param value output - the value
+ * @return 1 on success, 0 if the field is not a decimal
+ */
+int ParseDecimal(const char *field, size_t length, size_t available, double *value){
+    if (SWAR_DIGITS && CLINGER_FAST_PATH && length <= SWAR_WORD_SIZE && available >= SWAR_WORD_SIZE &&
+        ParseShortDecimal(field, length, value)){
+        return 1;
+    }
+    size_t position = 0;
+    bool negative = false;
+    if (field[0] == '+' || field[0] == '-'){
+        negative = field[0] == '-';
+        ++position;
+    }
+    size_t integer_start = position;
+    size_t integer_digits = CountDigits(field + position, length - position);
+    position += integer_digits;
+    size_t fraction_start = position, fraction_digits = 0;
+    if (position < length && field[position] == '.'){
+        fraction_start = ++position;
+        fraction_digits = CountDigits(field + position, length - position);
+        position += fraction_digits;
+    }
+    long exponent = 0;
+    if (position < length && (field[position] == 'e' || field[position] == 'E')){
+        ++position;
+        bool negative_exponent = false;
+        if (position < length && (field[position] == '+' || field[position] == '-')){
+            negative_exponent = field[position] == '-';
+            ++position;
+        }
+        size_t exponent_digits = CountDigits(field + position, length - position);
+        if (exponent_digits == 0 || exponent_digits > MAX_EXPONENT_DIGITS){
+            return ParseDecimalWithStrtod(field, length, value);
+        }
+        for (size_t i = 0; i < exponent_digits; ++i) {
+            exponent = exponent*10 + (field[position + i] - '0');
+        }
+        exponent = negative_exponent ? -exponent : exponent;
+        position += exponent_digits;
+    }
+    if (!CLINGER_FAST_PATH || position != length || integer_digits + fraction_digits == 0 ||
+        integer_digits + fraction_digits > MEETING_LINE_MAX_ID_DIGITS){
+        // inf, nan, hex, too many digits - or not a number at all
+        return ParseDecimalWithStrtod(field, length, value);
+    }
+    uint64_t integer_part = 0, fraction_part = 0;
+    if ((integer_digits && !ParseDigits(field + integer_start, integer_digits, available - integer_start,
+                                        &integer_part)) ||
+        (fraction_digits && !ParseDigits(field + fraction_start, fraction_digits, available - fraction_start,
+                                         &fraction_part))){
+        return 0;
+    }
+    uint64_t mantissa = integer_part*g_integer_powers_of_10[fraction_digits] + fraction_part;
+    exponent -= (long) fraction_digits;
+    if (mantissa > MAX_EXACT_MANTISSA || exponent < -MEETING_LINE_MAX_FAST_EXPONENT ||
+        exponent > MEETING_LINE_MAX_FAST_EXPONENT){
+        return ParseDecimalWithStrtod(field, length, value);
+    }
+    // both operands are exact doubles, so the single operation is correctly rounded
+    double result = exponent >= 0 ? (double) mantissa*g_powers_of_10[exponent] :
+                    (double) mantissa/g_powers_of_10[-exponent];
+    *value = negative ? -result : result;
+    return 1;
+}
+
+/**
+ * This function parses a decimal of up to 8 characters - digits with at most one '.' - as a single
+ * word: the '.' is found and removed inside the word, and the rest is converted as 8 digits
+ * @param field the field (8 readable bytes)
+ * @param length the length of the field (at most 8)
+ * @param value output - the value
+ * @return 1 on success, 0 if the field is not of this form (ParseDecimal then parses it)
+ */
+int ParseShortDecimal(const char *field, size_t length, double *value){
+    uint64_t word;
+    memcpy(&word, field, SWAR_WORD_SIZE);
+    // the lowest zero byte of word ^ "........" is the first '.'
+    uint64_t dots = word ^ SWAR_DOTS;
+    dots = (dots - 0x0101010101010101ULL) & ~dots & 0x8080808080808080ULL;
+    size_t dot = dots ? (size_t) __builtin_ctzll(dots)/8 : SWAR_WORD_SIZE;
+    size_t digits = length, fraction_digits = 0;
+    if (dot < length){
+        if (dot == 0){
+            return 0;
+        }
+        uint64_t below_dot = (1ULL << (8*dot)) - 1;
+        word = (word & below_dot) | ((word >> 8) & ~below_dot);
+        digits = length - 1;
+        fraction_digits = length - 1 - dot;
+    }
+    if (digits == 0){
+        return 0;
+    }
+    if (digits < SWAR_WORD_SIZE){
+        word = (word << (8*(SWAR_WORD_SIZE - digits))) | (SWAR_ZEROS >> (8*digits));
+    }
+    if (!IsEightDigits(word)){
+        return 0;
+    }
+    // at most 8 digits - the mantissa is exact, so the division is correctly rounded
+    *value = (double) ConvertEightDigits(word)/g_powers_of_10[fraction_digits];
+    return 1;
+}
+
+/**
+ * This function parses a decimal with strtod (the slow path of ParseDecimal)
+ * @param field the field (followed by a character which ends it)
+ * @param length the length of the field
+ * @param value output - the value
+ * @return 1 on success, 0 if strtod does not consume exactly the field
+ */
+int ParseDecimalWithStrtod(const char *field, size_t length, double *value){
+    char *end;
+    double result = strtod(field, &end);
+    if (end != field + length){
+        return 0;
+    }
+    *value = result;
+    return 1;
+}
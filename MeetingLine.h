@@ -0,0 +1,63 @@
+#ifndef MEETINGLINE_H
+#define MEETINGLINE_H
+
+#include "Person.h"
+
+/**
+ * ======================= meetings lines ========================
+ * A parser for the lines of the meetings file - "<id_1> <id_2> <distance> <measure>",
+ * separated by spaces or tabs (a trailing '\r' / '\n' is allowed), in place of
+ * sscanf("%zd %zd %lf %lf"):
+ * - The ends of the fields are found 16 bytes at a time (SSE2, when compiled for it -
+ *   __SSE2__ is defined on every x86-64 compiler; any other target uses a scalar loop).
+ * - The ids are converted 8 digits at a time (SWAR - the digits are checked and combined
+ *   inside a 64 bit word).
+ * - A decimal with at most 19 significant digits whose value and power of 10 are exact doubles
+ *   is a single correctly rounded multiplication or division (Clinger's fast path); any other
+ *   decimal (more digits, large exponents, inf / nan, hex) is converted by strtod.
+ * Unlike sscanf, a line with a missing field, a non numeric field, a negative id or anything
+ * after the fourth field is rejected.
+ * ================================================================
+ */
+
+/**
+ * @def MEETING_LINE_MAX_ID_DIGITS
+ * the maximal number of digits of an id converted without an overflow check
+ * (longer ids are converted with an overflow check).
+ */
+#define MEETING_LINE_MAX_ID_DIGITS 19
+
+/**
+ * @def MEETING_LINE_MAX_FAST_EXPONENT
+ * the maximal power of 10 which is an exact double (the fast path of the decimals).
+ */
+#define MEETING_LINE_MAX_FAST_EXPONENT 22
+
+/**
+ * @struct MeetingLine
+ * The fields of a meetings line.
+ * @param id_1 the id of the first person.
+ * @param id_2 the id of the second person.
+ * @param distance the distance of the meeting.
+ * @param measure the measure of the meeting.
+ */
+typedef struct MeetingLine {
+  IdT id_1;
+  IdT id_2;
+  double distance;
+  double measure;
+} MeetingLine;
+
+/**
+ * Parses a meetings line.
+ * @param line the line ('\0' terminated).
+ * @param capacity the size of the buffer holding the line - the parser may read (but does not use)
+ * the bytes after the '\0', up to capacity; pass strlen(line) + 1 if they are not readable.
+ * @param meeting_line output - the fields of the line.
+ * @return 1 if the line was parsed successfully, 0 if it is malformed.
+ * @if_fails returns 0 (meeting_line is then undefined).
+ * @assumption you can not assume anything.
+ */
+int MeetingLineParse(const char *line, size_t capacity, MeetingLine *meeting_line);
+
+#endif //MEETINGLINE_H
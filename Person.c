@@ -4,6 +4,7 @@
 
 #include "Person.h"
 #include <stdbool.h>
+#include "SpreaderAlloc.h"
 
 
 /**
@@ -38,7 +39,9 @@ void PersonFree(Person **p_person){
     if (!p_person || !(*p_person)){
         return;
     }
+    free((*p_person)->name);
     free((*p_person)->meetings);
+    free((*p_person)->incoming);
     free(*p_person);
     *p_person = NULL;
 }
@@ -48,6 +48,14 @@ typedef size_t IdT;
  * @param num_of_meetings the number of meetings the person owns.
  * @param meetings_capacity the capacity of the meetings array,
  * - the number of seats you allocated for Meeting* elements.
+ * @param slot the index of the person in the people array of the
+ * spreader detector which holds him/her.
+ * @param incoming a dynamic array of pointers to the meetings in which the
+ * person is person_2 (kept by the spreader detector for the lazy rates only).
+ * - note - each person owns the dynamic array, but not the
+ * meetings themselves.
+ * @param num_of_incoming the number of incoming meetings.
+ * @param incoming_capacity the capacity of the incoming array.
  */
 typedef struct Person {
   IdT id;
@@ -58,6 +66,10 @@ typedef struct Person {
   Meeting **meetings;
   size_t num_of_meetings;
   size_t meetings_capacity;
+  size_t slot;
+  Meeting **incoming;
+  size_t num_of_incoming;
+  size_t incoming_capacity;
 } Person;
 
 /**
@@ -0,0 +1,172 @@
+#define SPREADER_ALLOC_NO_WRAP
+#include "SpreaderAlloc.h"
+
+#ifdef SPREADER_DETECTOR_TRACK_ALLOCATIONS
+
+#include <stdatomic.h>
+#include <malloc.h>
+
+/**
+ * @struct PhaseCounters
+ * The counters of a single phase (see SpreaderAllocStats).
+ */
+typedef struct PhaseCounters {
+  atomic_size_t malloc_calls;
+  atomic_size_t calloc_calls;
+  atomic_size_t realloc_calls;
+  atomic_size_t free_calls;
+  atomic_size_t allocated_bytes;
+  atomic_size_t peak_bytes;
+} PhaseCounters;
+
+void CountAllocation(atomic_size_t *calls, void *ptr, size_t old_size);
+void UpdatePeak(atomic_size_t *peak, long long live);
+
+static const char *g_phase_names[SPREADER_ALLOC_NUM_OF_PHASES] = {"other", "read_people", "read_meetings",
+                                                                  "calculate", "print"};
+static PhaseCounters g_counters[SPREADER_ALLOC_NUM_OF_PHASES];
+static _Atomic SpreaderAllocPhase g_phase = SPREADER_ALLOC_OTHER;
+// signed - a pointer allocated outside of the wrappers may be freed through them
+static atomic_llong g_live_bytes;
+
+
+/**
+ * Sets the phase the following allocations (of all threads) are counted in.
+ * @param phase the phase.
+ * @return the previous phase.
+ */
+SpreaderAllocPhase SpreaderAllocSetPhase(SpreaderAllocPhase phase){
+    if (phase >= SPREADER_ALLOC_NUM_OF_PHASES){
+        return atomic_load(&g_phase);
+    }
+    SpreaderAllocPhase previous = atomic_exchange(&g_phase, phase);
+    long long live = atomic_load(&g_live_bytes);
+    UpdatePeak(&g_counters[phase].peak_bytes, live);
+    return previous;
+}
+
+/**
+ * Returns the allocations of the given phase.
+ * @param phase the phase.
+ * @param stats output - the allocations of the phase.
+ * @return 1 on success, 0 otherwise.
+ * @if_fails returns 0 (unknown phase or NULL stats).
+ */
+int SpreaderAllocGetStats(SpreaderAllocPhase phase, SpreaderAllocStats *stats){
+    if (phase >= SPREADER_ALLOC_NUM_OF_PHASES || !stats){
+        return 0;
+    }
+    PhaseCounters *counters = &g_counters[phase];
+    stats->malloc_calls = atomic_load(&counters->malloc_calls);
+    stats->calloc_calls = atomic_load(&counters->calloc_calls);
+    stats->realloc_calls = atomic_load(&counters->realloc_calls);
+    stats->free_calls = atomic_load(&counters->free_calls);
+    stats->allocated_bytes = atomic_load(&counters->allocated_bytes);
+    stats->peak_bytes = atomic_load(&counters->peak_bytes);
+    return 1;
+}
+
+/**
+ * Returns the number of live heap bytes allocated through the wrappers.
+ * @return the number of live bytes.
+ */
+size_t SpreaderAllocGetLiveBytes(){
+    long long live = atomic_load(&g_live_bytes);
+    return live > 0 ? (size_t) live : 0;
+}
+
+/**
+ * Resets the counters of all the phases (the live bytes are kept).
+ */
+void SpreaderAllocResetStats(){
+    for (size_t i = 0; i < SPREADER_ALLOC_NUM_OF_PHASES; ++i) {
+        atomic_store(&g_counters[i].malloc_calls, 0);
+        atomic_store(&g_counters[i].calloc_calls, 0);
+        atomic_store(&g_counters[i].realloc_calls, 0);
+        atomic_store(&g_counters[i].free_calls, 0);
+        atomic_store(&g_counters[i].allocated_bytes, 0);
+        atomic_store(&g_counters[i].peak_bytes, 0);
+    }
+}
+
+/**
+ * Prints the allocations of each phase to the given file, one phase per line.
+ * @param file the file.
+ */
+void SpreaderAllocPrintStats(FILE *file){
+    if (!file){
+        return;
+    }
+    for (size_t i = 0; i < SPREADER_ALLOC_NUM_OF_PHASES; ++i) {
+        SpreaderAllocStats stats;
+        SpreaderAllocGetStats((SpreaderAllocPhase) i, &stats);
+        fprintf(file, "%s: malloc %zu calloc %zu realloc %zu free %zu allocated %zu peak %zu\n",
+                g_phase_names[i], stats.malloc_calls, stats.calloc_calls, stats.realloc_calls,
+                stats.free_calls, stats.allocated_bytes, stats.peak_bytes);
+    }
+}
+
+void *SpreaderAllocMalloc(size_t size){
+    void *ptr = malloc(size);
+    CountAllocation(&g_counters[atomic_load(&g_phase)].malloc_calls, ptr, 0);
+    return ptr;
+}
+
+void *SpreaderAllocCalloc(size_t num, size_t size){
+    void *ptr = calloc(num, size);
+    CountAllocation(&g_counters[atomic_load(&g_phase)].calloc_calls, ptr, 0);
+    return ptr;
+}
+
+void *SpreaderAllocRealloc(void *ptr, size_t size){
+    size_t old_size = ptr ? malloc_usable_size(ptr) : 0;
+    void *new_ptr = realloc(ptr, size);
+    if (!new_ptr && size != 0){
+        // the old block is still allocated
+        atomic_fetch_add(&g_counters[atomic_load(&g_phase)].realloc_calls, 1);
+        return NULL;
+    }
+    CountAllocation(&g_counters[atomic_load(&g_phase)].realloc_calls, new_ptr, old_size);
+    return new_ptr;
+}
+
+void SpreaderAllocFree(void *ptr){
+    if (!ptr){
+        return;
+    }
+    atomic_fetch_add(&g_counters[atomic_load(&g_phase)].free_calls, 1);
+    atomic_fetch_sub(&g_live_bytes, (long long) malloc_usable_size(ptr));
+    free(ptr);
+}
+
+/**
+ * This function counts an allocation in the current phase and updates the live bytes
+ * @param calls the calls counter of the allocating function
+ * @param ptr the allocated block (NULL if the allocation failed)
+ * @param old_size the usable size of the block the allocation replaced (0 if none)
+ */
+void CountAllocation(atomic_size_t *calls, void *ptr, size_t old_size){
+    PhaseCounters *counters = &g_counters[atomic_load(&g_phase)];
+    atomic_fetch_add(calls, 1);
+    size_t size = ptr ? malloc_usable_size(ptr) : 0;
+    atomic_fetch_add(&counters->allocated_bytes, size);
+    long long live = atomic_fetch_add(&g_live_bytes, (long long) size - (long long) old_size) +
+                     (long long) size - (long long) old_size;
+    UpdatePeak(&counters->peak_bytes, live);
+}
+
+/**
+ * This function raises the peak of a phase to the given live bytes
+ * @param peak the peak of the phase
+ * @param live the live bytes
+ */
+void UpdatePeak(atomic_size_t *peak, long long live){
+    if (live <= 0){
+        return;
+    }
+    size_t current = atomic_load(peak);
+    while ((size_t) live > current && !atomic_compare_exchange_weak(peak, &current, (size_t) live)) {
+    }
+}
+
+#endif //SPREADER_DETECTOR_TRACK_ALLOCATIONS
@@ -0,0 +1,108 @@
+#ifndef SPREADERALLOC_H
+#define SPREADERALLOC_H
+
+#include <stdlib.h>
+#include <stdio.h>
+
+/**
+ * ======================= allocation tracking ========================
+ * Compiling every file with -DSPREADER_DETECTOR_TRACK_ALLOCATIONS (and adding
+ * SpreaderAlloc.c to the build) routes the malloc / calloc / realloc / free calls
+ * of the spreader detector files through counting wrappers. The counts are kept
+ * per phase (reading the people, reading the meetings, calculating, printing),
+ * together with the peak of the live heap bytes seen during each phase.
+ * The live bytes are measured with malloc_usable_size (glibc), so they include
+ * the rounding of the allocator, but not its headers.
+ * Without the flag this header only defines SPREADER_ALLOC_SET_PHASE as a no-op.
+ * This header must be the last one included by a source file.
+ * ====================================================================
+ */
+
+/**
+ * @enum SpreaderAllocPhase
+ * The phases the allocations are counted by.
+ */
+typedef enum SpreaderAllocPhase {
+  SPREADER_ALLOC_OTHER = 0,
+  SPREADER_ALLOC_READ_PEOPLE,
+  SPREADER_ALLOC_READ_MEETINGS,
+  SPREADER_ALLOC_CALCULATE,
+  SPREADER_ALLOC_PRINT,
+  SPREADER_ALLOC_NUM_OF_PHASES
+} SpreaderAllocPhase;
+
+/**
+ * @struct SpreaderAllocStats
+ * The allocations of a single phase.
+ * @param malloc_calls the number of malloc calls.
+ * @param calloc_calls the number of calloc calls.
+ * @param realloc_calls the number of realloc calls.
+ * @param free_calls the number of free calls (of non NULL pointers).
+ * @param allocated_bytes the number of bytes allocated (a realloc counts its new size).
+ * @param peak_bytes the maximal number of live heap bytes seen during the phase.
+ */
+typedef struct SpreaderAllocStats {
+  size_t malloc_calls;
+  size_t calloc_calls;
+  size_t realloc_calls;
+  size_t free_calls;
+  size_t allocated_bytes;
+  size_t peak_bytes;
+} SpreaderAllocStats;
+
+#ifdef SPREADER_DETECTOR_TRACK_ALLOCATIONS
+
+/**
+ * Sets the phase the following allocations (of all threads) are counted in.
+ * @param phase the phase.
+ * @return the previous phase.
+ */
+SpreaderAllocPhase SpreaderAllocSetPhase(SpreaderAllocPhase phase);
+
+/**
+ * Returns the allocations of the given phase.
+ * @param phase the phase.
+ * @param stats output - the allocations of the phase.
+ * @return 1 on success, 0 otherwise.
+ * @if_fails returns 0 (unknown phase or NULL stats).
+ */
+int SpreaderAllocGetStats(SpreaderAllocPhase phase, SpreaderAllocStats *stats);
+
+/**
+ * Returns the number of live heap bytes allocated through the wrappers.
+ * @return the number of live bytes.
+ */
+size_t SpreaderAllocGetLiveBytes();
+
+/**
+ * Resets the counters of all the phases (the live bytes are kept).
+ */
+void SpreaderAllocResetStats();
+
+/**
+ * Prints the allocations of each phase to the given file, one phase per line.
+ * @param file the file.
+ */
+void SpreaderAllocPrintStats(FILE *file);
+
+void *SpreaderAllocMalloc(size_t size);
+void *SpreaderAllocCalloc(size_t num, size_t size);
+void *SpreaderAllocRealloc(void *ptr, size_t size);
+void SpreaderAllocFree(void *ptr);
+
+#ifndef SPREADER_ALLOC_NO_WRAP
+#define malloc(size) SpreaderAllocMalloc(size)
+#define calloc(num, size) SpreaderAllocCalloc(num, size)
+#define realloc(ptr, size) SpreaderAllocRealloc(ptr, size)
+#define free(ptr) SpreaderAllocFree(ptr)
+#endif
+
+#define SPREADER_ALLOC_SET_PHASE(phase) SpreaderAllocSetPhase(phase)
+
+#else
+
+#define SPREADER_ALLOC_SET_PHASE(phase) ((void) (phase), SPREADER_ALLOC_OTHER)
+
+#endif //SPREADER_DETECTOR_TRACK_ALLOCATIONS
+
+#endif //SPREADERALLOC_H
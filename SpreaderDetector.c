@@ -4,14 +4,82 @@
 
 
 #include "SpreaderDetector.h"
+#include "InputStream.h"
+#include "MeetingLine.h"
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sched.h>
+#include "SpreaderAlloc.h"
 
 
-int PersonExist(Person *person, Person **people, size_t peopleSize);
+/**
+ * @struct PropagationTasks
+ * The components which should be propagated, shared between the propagation threads.
+ * @param spreader_detector the spreader detector.
+ * @param tasks the components holding a sick person (largest first).
+ * @param num_of_tasks the number of tasks.
+ * @param sick_start the range of each component inside sick_slots (size: components + 1).
+ * @param sick_slots the slots of the sick people, grouped by component.
+ * @param offsets the range of each component in the propagation stacks (the people before it).
+ * @param epoch the propagation.
+ * @param rates the back buffer the rates are calculated into (by slot).
+ * @param next the next task to take.
+ */
+typedef struct PropagationTasks {
+  SpreaderDetector *spreader_detector;
+  SpreaderComponent **tasks;
+  size_t num_of_tasks;
+  size_t *sick_start;
+  size_t *sick_slots;
+  size_t *offsets;
+  size_t epoch;
+  double *rates;
+  atomic_size_t next;
+} PropagationTasks;
+
+int PersonExist(SpreaderDetector *spreader_detector, Person *person);
+void *GrowBulkArray(void *array, SpreaderRegion *region, size_t *capacity);
+void FreeBulkArray(void *array, SpreaderRegion *region);
 int AddMeetingToPerson(Person* person, Meeting* meeting);
-Person* GetPersonById(Person** people, size_t size, IdT id);
-void UpdateRate(Person* root);
-void CalcCrna(Person* person1, Person* person2, double measure, double distance);
+int AddIncomingToPerson(Person* person, Meeting* meeting);
+int AppendMeeting(Meeting ***p_meetings, size_t *size, size_t *capacity, Meeting *meeting);
+size_t HashId(IdT id, size_t capacity);
+int GrowIdIndex(SpreaderDetector *spreader_detector);
+void FillIdIndex(Person **people, size_t size, size_t *index, size_t capacity);
+int ReservePropagationScratch(SpreaderDetector *spreader_detector);
+void StampPropagationMark(SpreaderDetector *spreader_detector, size_t slot, size_t epoch);
+void PropagateReached(SpreaderDetector *spreader_detector, const size_t *starts, size_t num_of_starts,
+                      size_t epoch, int restricted, size_t offset, double *rates);
+void PropagateCycle(SpreaderDetector *spreader_detector, const size_t *members, size_t size,
+                    size_t *queue, double *rates);
+double CalcCrna(const Meeting *meeting, const double *weights, const double *additions, double rate);
+int UpdatePolicyColumns(SpreaderDetector *spreader_detector);
+RateSnapshot *PrepareBackBuffer(SpreaderDetector *spreader_detector);
+void PublishBackBuffer(SpreaderDetector *spreader_detector, RateSnapshot *back);
+size_t FindRoot(size_t *parents, size_t slot);
+int CompareComponentsBySize(const void *a, const void *b);
+void *PropagateComponents(void *arg);
+size_t GetNumOfThreads(size_t num_of_tasks);
+size_t GetLogChunk(size_t index, size_t *offset);
+int CompareLogEntries(const void *a, const void *b);
+int ReadMeetings(SpreaderDetector *spreader_detector, InputStream *file);
+int ReadPeople(SpreaderDetector *spreader_detector, InputStream *file);
+void CalculateInfectionChances(SpreaderDetector *spreader_detector);
+size_t *BuildContactLists(const SpreaderDetector *spreader_detector, size_t **p_neighbours);
+int SortContactListsByDegree(const size_t *offsets, size_t **p_neighbours, size_t size, const size_t *by_degree);
+int SortByDegree(const size_t *offsets, size_t size, int ascending, size_t *by_degree);
+int OrderBreadthFirst(const size_t *offsets, const size_t *neighbours, size_t size,
+                      const size_t *starts, size_t *order);
+int ApplyOrder(SpreaderDetector *spreader_detector, const size_t *order);
+int BuildIncomingMeetings(SpreaderDetector *spreader_detector);
+int EvaluateLazyRate(SpreaderDetector *spreader_detector, size_t slot);
+int PushLazySlot(SpreaderDetector *spreader_detector, size_t *size, size_t slot);
+int ReserveNeighborhoodScratch(SpreaderDetector *spreader_detector);
+int VisitNeighbor(SpreaderDetector *spreader_detector, Person *person, const Meeting *meeting, double rate,
+                  size_t hops, SpreaderNeighborhood *neighborhood, size_t *next_size);
 
 
 /**
@@ -22,16 +90,89 @@ void CalcCrna(Person* person1, Person* person2, double measure, double distance)
  * @assumption you can not assume anything.
  */
 SpreaderDetector *SpreaderDetectorAlloc(){
-    return calloc(1, sizeof(SpreaderDetector));
+    SpreaderDetector *spreader_detector = calloc(1, sizeof(SpreaderDetector));
+    if (!spreader_detector){
+        return NULL;
+    }
+    for (size_t i = 0; i < SPREADER_DETECTOR_NUM_OF_STRIPES; ++i) {
+        pthread_mutex_init(&spreader_detector->person_locks[i], NULL);
+    }
+    for (size_t i = 0; i < SPREADER_DETECTOR_LOG_CHUNKS; ++i) {
+        atomic_init(&spreader_detector->meeting_log[i], NULL);
+    }
+    atomic_init(&spreader_detector->meeting_log_size, 0);
+    atomic_init(&spreader_detector->rate_readers[0], 0);
+    atomic_init(&spreader_detector->rate_readers[1], 0);
+    atomic_init(&spreader_detector->rate_front, SPREADER_DETECTOR_NO_SNAPSHOT);
+    spreader_detector->lazy_epoch = 1;
+    return spreader_detector;
 }
 
 
+/**
+ * Places the people array and the meetings array in regions (see SpreaderRegion.h) in place of the heap:
+ * the address space of max_people / max_meetings pointers is reserved up front, and each array grows
+ * in place (committed a huge page at a time) - it is never copied, and never moves. The regions use
+ * transparent huge pages, and with SPREADER_NUMA_INTERLEAVE their pages are interleaved between
+ * the NUMA nodes (the parallel propagation reads them from all the nodes).
+ * The capacities are then hard limits - adding a person or a meeting beyond them fails.
+ * Must be called before the first person is added.
+ * @param spreader_detector the spreader detector.
+ * @param max_people the maximal number of people.
+ * @param max_meetings the maximal number of meetings.
+ * @param numa_policy the placement of the pages of the regions.
+ * @return 1 if the regions were reserved successfully, 0 otherwise.
+ * @if_fails returns 0 (the arrays stay on the heap).
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorSetPlacement(SpreaderDetector *spreader_detector, size_t max_people,
+                                 size_t max_meetings, SpreaderNumaPolicy numa_policy){
+    if (!spreader_detector || spreader_detector->people || spreader_detector->meetings ||
+        atomic_load(&spreader_detector->meeting_log_size) != 0 ||
+        max_people == 0 || max_meetings == 0 ||
+        max_people > SIZE_MAX/sizeof(void *) || max_meetings > SIZE_MAX/sizeof(void *)){
+        return 0;
+    }
+    SpreaderRegion people_region, meetings_region;
+    if (!SpreaderRegionReserve(&people_region, max_people*sizeof(void *), numa_policy)){
+        return 0;
+    }
+    if (!SpreaderRegionReserve(&meetings_region, max_meetings*sizeof(void *), numa_policy)){
+        SpreaderRegionRelease(&people_region);
+        return 0;
+    }
+    spreader_detector->people_region = people_region;
+    spreader_detector->meetings_region = meetings_region;
+    return 1;
+}
+
 void SpreaderDetectorFree(SpreaderDetector **p_spreader_detector){
     if (!p_spreader_detector || !(*p_spreader_detector)){
         return;
     }
-    free((*p_spreader_detector)->meetings);
-    free((*p_spreader_detector)->people);
+    FreeBulkArray((*p_spreader_detector)->meetings, &(*p_spreader_detector)->meetings_region);
+    FreeBulkArray((*p_spreader_detector)->people, &(*p_spreader_detector)->people_region);
+    free((*p_spreader_detector)->id_index);
+    for (size_t i = 0; i < SPREADER_DETECTOR_NUM_OF_STRIPES; ++i) {
+        pthread_mutex_destroy(&(*p_spreader_detector)->person_locks[i]);
+    }
+    for (size_t i = 0; i < SPREADER_DETECTOR_LOG_CHUNKS; ++i) {
+        free(atomic_load(&(*p_spreader_detector)->meeting_log[i]));
+    }
+    free((*p_spreader_detector)->rate_snapshots[0].rates);
+    free((*p_spreader_detector)->rate_snapshots[1].rates);
+    free((*p_spreader_detector)->person_additions);
+    free((*p_spreader_detector)->meeting_weights);
+    free((*p_spreader_detector)->component_of);
+    free((*p_spreader_detector)->components);
+    free((*p_spreader_detector)->file_order);
+    free((*p_spreader_detector)->lazy_rates);
+    free((*p_spreader_detector)->lazy_stack);
+    free((*p_spreader_detector)->neighborhood_marks);
+    free((*p_spreader_detector)->neighborhood_queue);
+    free((*p_spreader_detector)->neighborhood_next);
+    free((*p_spreader_detector)->propagation_marks);
+    free((*p_spreader_detector)->propagation_stacks);
     free(*p_spreader_detector);
     *p_spreader_detector = NULL;
 }
@@ -50,45 +191,137 @@ int SpreaderDetectorAddPerson(SpreaderDetector *spreader_detector, Person *perso
         return 0;
     }
 
-    if (PersonExist(person, spreader_detector->people,
-                    spreader_detector->people_size) == true) return 0;
+    if (PersonExist(spreader_detector, person) == true) return 0;
 
     if (spreader_detector->people_size == spreader_detector->people_cap){
-        if (spreader_detector->people_cap == 0){
-            spreader_detector->people_cap = SPREADER_DETECTOR_INITIAL_SIZE;
-        }
-        else {
-            spreader_detector->people_cap *= SPREADER_DETECTOR_GROWTH_FACTOR;
-        }
+        size_t capacity = spreader_detector->people_cap == 0 ? SPREADER_DETECTOR_INITIAL_SIZE :
+                          spreader_detector->people_cap*SPREADER_DETECTOR_GROWTH_FACTOR;
 
-        Person **temp = realloc(spreader_detector->people,
-                                spreader_detector->people_cap*sizeof(void *));
-        if (!temp) return 0;
+        Person **temp = GrowBulkArray(spreader_detector->people, &spreader_detector->people_region, &capacity);
+        if (!temp || capacity == spreader_detector->people_size) return 0;
 
         spreader_detector->people = temp;
+        spreader_detector->people_cap = capacity;
         temp = NULL;
     }
+    if (spreader_detector->file_order && spreader_detector->file_order_cap == spreader_detector->people_size){
+        size_t capacity = spreader_detector->file_order_cap * SPREADER_DETECTOR_GROWTH_FACTOR;
+        size_t *temp = realloc(spreader_detector->file_order, capacity*sizeof(size_t));
+        if (!temp) return 0;
+        spreader_detector->file_order = temp;
+        spreader_detector->file_order_cap = capacity;
+    }
+    // keep the index at most half full
+    if (2*(spreader_detector->people_size + 1) > spreader_detector->id_index_cap){
+        if (!GrowIdIndex(spreader_detector)) return 0;
+    }
 
+    person->slot = spreader_detector->people_size;
+    if (spreader_detector->file_order){
+        spreader_detector->file_order[person->slot] = person->slot;
+    }
     spreader_detector->people[spreader_detector->people_size++] = person;
+    size_t bucket = HashId(person->id, spreader_detector->id_index_cap);
+    while (spreader_detector->id_index[bucket]) {
+        bucket = (bucket + 1) & (spreader_detector->id_index_cap - 1);
+    }
+    spreader_detector->id_index[bucket] = person->slot + 1;
+    spreader_detector->lazy_epoch++;
     return 1;
 }
 
 /**
- * This function gets person and persons array (with size) and return true if the
- * input person is in the input array
+ * This function gets person and spreader detector and return true if a person
+ * with the same id is in the spreader detector
+ * @param spreader_detector the spreader detector to search in
  * @param person Person to find
- * @param people array (pointer) of Person to search in it
- * @param peopleSize size of array
  * @return true if the person exist, false otherwise
  */
-int PersonExist(Person *person, Person **people, size_t peopleSize){
-    if (!person || !people) return false;
-    for (size_t i = 0; i < peopleSize; ++i) {
-        if (PersonCompareById(people[i], person) == 0){
-            return true;
+int PersonExist(SpreaderDetector *spreader_detector, Person *person){
+    if (!person) return false;
+    return SpreaderDetectorGetPersonById(spreader_detector, person->id) != NULL;
+}
+
+/**
+ * This function grows the people array or the meetings array - in place, in its region, if it has one
+ * (up to the end of the region), and with realloc otherwise
+ * @param array the array (pointers)
+ * @param region the region of the array
+ * @param capacity the requested capacity - updated to the capacity the array got
+ * @return the grown array, NULL on failure (the array is then unchanged)
+ */
+void *GrowBulkArray(void *array, SpreaderRegion *region, size_t *capacity){
+    if (!region->base){
+        return realloc(array, *capacity*sizeof(void *));
+    }
+    size_t limit = region->reserved/sizeof(void *);
+    size_t bytes = (*capacity < limit ? *capacity : limit)*sizeof(void *);
+    if (!SpreaderRegionCommit(region, bytes)){
+        return NULL;
+    }
+    // the whole committed part (at least a huge page) is usable
+    *capacity = region->committed/sizeof(void *);
+    return region->base;
+}
+
+/**
+ * This function frees the people array or the meetings array (releases its region, if it has one)
+ * @param array the array
+ * @param region the region of the array
+ */
+void FreeBulkArray(void *array, SpreaderRegion *region){
+    if (region->base){
+        SpreaderRegionRelease(region);
+    }
+    else {
+        free(array);
+    }
+}
+
+/**
+ * This function maps an id to its first bucket in the id index
+ * (Fibonacci hashing - ids are often sequential).
+ * @param id the id to hash
+ * @param capacity the capacity of the index (a power of 2)
+ * @return the bucket of the id
+ */
+size_t HashId(IdT id, size_t capacity){
+    return (size_t) (((unsigned long long) id * 0x9E3779B97F4A7C15ULL) >> 32U) & (capacity - 1);
+}
+
+/**
+ * This function doubles the id index of the spreader detector and re-inserts
+ * all the people into it
+ * @param spreader_detector the spreader detector
+ * @return true if the index was grown, false otherwise
+ */
+int GrowIdIndex(SpreaderDetector *spreader_detector){
+    size_t capacity = spreader_detector->id_index_cap == 0 ? 2*SPREADER_DETECTOR_INITIAL_SIZE :
+                      spreader_detector->id_index_cap * SPREADER_DETECTOR_GROWTH_FACTOR;
+    size_t *index = calloc(capacity, sizeof(size_t));
+    if (!index) return false;
+    FillIdIndex(spreader_detector->people, spreader_detector->people_size, index, capacity);
+    free(spreader_detector->id_index);
+    spreader_detector->id_index = index;
+    spreader_detector->id_index_cap = capacity;
+    return true;
+}
+
+/**
+ * This function inserts the given people (by their slot in the array) into an empty id index
+ * @param people the people
+ * @param size the number of people
+ * @param index the id index (all buckets empty)
+ * @param capacity the capacity of the index (a power of 2)
+ */
+void FillIdIndex(Person **people, size_t size, size_t *index, size_t capacity){
+    for (size_t i = 0; i < size; ++i) {
+        size_t bucket = HashId(people[i]->id, capacity);
+        while (index[bucket]) {
+            bucket = (bucket + 1) & (capacity - 1);
         }
+        index[bucket] = i + 1;
     }
-    return false;
 }
 
 
@@ -106,34 +339,34 @@ int SpreaderDetectorAddMeeting(SpreaderDetector *spreader_detector, Meeting *mee
     if (!spreader_detector || !meeting || !spreader_detector->people){
         return 0;
     }
-    if (PersonExist(meeting->person_1, spreader_detector->people,
-                    spreader_detector->people_size) == false) return 0;
+    if (PersonExist(spreader_detector, meeting->person_1) == false) return 0;
 
-    if (PersonExist(meeting->person_2, spreader_detector->people,
-                    spreader_detector->people_size) == false) return 0;
+    if (PersonExist(spreader_detector, meeting->person_2) == false) return 0;
 
     // person1 has this meeting:
     if (meeting == PersonGetMeetingById(meeting->person_1, meeting->person_2->id)) return 0;
 
     // realoc meetings
     if (spreader_detector->meeting_size == spreader_detector->meeting_cap){
-        if (spreader_detector->meeting_cap == 0){
-            spreader_detector->meeting_cap = SPREADER_DETECTOR_INITIAL_SIZE;
-        }
-        else {
-            spreader_detector->meeting_cap *= SPREADER_DETECTOR_GROWTH_FACTOR;
-        }
+        size_t capacity = spreader_detector->meeting_cap == 0 ? SPREADER_DETECTOR_INITIAL_SIZE :
+                          spreader_detector->meeting_cap*SPREADER_DETECTOR_GROWTH_FACTOR;
 
-        Meeting **temp = realloc(spreader_detector->meetings,
-                                spreader_detector->meeting_cap*sizeof(void *));
-        if (!temp) return 0;
+        Meeting **temp = GrowBulkArray(spreader_detector->meetings, &spreader_detector->meetings_region, &capacity);
+        if (!temp || capacity == spreader_detector->meeting_size) return 0;
 
         spreader_detector->meetings = temp;
+        spreader_detector->meeting_cap = capacity;
         temp = NULL;
     }
 
     if (AddMeetingToPerson(meeting->person_1, meeting) == false) return 0;
+    meeting->index = spreader_detector->meeting_size;
     spreader_detector->meetings[spreader_detector->meeting_size++] = meeting;
+    // without room for the incoming meeting the lazy rates rebuild the incoming meetings
+    if (spreader_detector->lazy_enabled && !AddIncomingToPerson(meeting->person_2, meeting)){
+        spreader_detector->lazy_enabled = false;
+    }
+    spreader_detector->lazy_epoch++;
     return 1;
 
 }
@@ -146,109 +379,329 @@ int SpreaderDetectorAddMeeting(SpreaderDetector *spreader_detector, Meeting *mee
  * @return true if the add succeed, false otherwise
  */
 int AddMeetingToPerson(Person* person, Meeting* meeting){
-    if (!person->meetings){
-        person->meetings = malloc(sizeof(void*));
-        if (!person->meetings) return false;
+    return AppendMeeting(&person->meetings, &person->num_of_meetings, &person->meetings_capacity, meeting);
+}
+
+/**
+ * This function gets person and meeting (in which he is person 2) and update
+ * that meeting to the person incoming meetings
+ * @param person the person to update its incoming meetings
+ * @param meeting Meeting to add
+ * @return true if the add succeed, false otherwise
+ */
+int AddIncomingToPerson(Person* person, Meeting* meeting){
+    return AppendMeeting(&person->incoming, &person->num_of_incoming, &person->incoming_capacity, meeting);
+}
+
+/**
+ * This function appends a meeting to a dynamic array of meetings of a person
+ * @param p_meetings the array
+ * @param size the size of the array
+ * @param capacity the capacity of the array
+ * @param meeting Meeting to add
+ * @return true if the add succeed, false otherwise
+ */
+int AppendMeeting(Meeting ***p_meetings, size_t *size, size_t *capacity, Meeting *meeting){
+    if (*size == *capacity){
+        size_t new_capacity = *capacity == 0 ? PERSON_INITIAL_SIZE : *capacity * PERSON_GROWTH_FACTOR;
+        Meeting **temp = realloc(*p_meetings, new_capacity*sizeof(void *));
+        if (!temp) return false;
+        *p_meetings = temp;
+        *capacity = new_capacity;
     }
-    person->meetings[person->num_of_meetings++] = meeting;
+    (*p_meetings)[(*size)++] = meeting;
     return true;
 }
 
 
+/**
+ * Adds the given meeting to the spreader detector - may be called from several
+ * threads at the same time (but not together with any other function which changes
+ * the spreader detector). The meeting is added to the meetings array of person_1
+ * right away, and to the meetings of the spreader detector by
+ * SpreaderDetectorCommitConcurrentMeetings.
+ * Important - the people in the meeting should exist in the spreader detector.
+ * @param spreader_detector the spreader detector we wants to add the meeting to.
+ * @param meeting the meeting we wants to add to the spreader detector.
+ * @param sequence the position of the meeting in the serial insertion order
+ * (for example, its line in the meetings file) - the committed graph is the graph
+ * SpreaderDetectorAddMeeting would build if called in this order.
+ * @return 1 if the meeting was added successfully, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorAddMeetingConcurrent(SpreaderDetector *spreader_detector, Meeting *meeting, size_t sequence){
+    // validation (the id index is only read here)
+    if (!spreader_detector || !meeting || !spreader_detector->people){
+        return 0;
+    }
+    if (PersonExist(spreader_detector, meeting->person_1) == false) return 0;
+
+    if (PersonExist(spreader_detector, meeting->person_2) == false) return 0;
+
+    // reserve an entry in the log, and allocate its chunk if this thread is the first to reach it
+    // (an entry which stays empty is skipped by the commit)
+    size_t offset, index = atomic_fetch_add(&spreader_detector->meeting_log_size, 1);
+    size_t chunk = GetLogChunk(index, &offset);
+    if (chunk >= SPREADER_DETECTOR_LOG_CHUNKS) return 0;
+    MeetingLogEntry *entries = atomic_load(&spreader_detector->meeting_log[chunk]);
+    if (!entries){
+        MeetingLogEntry *expected = NULL;
+        entries = calloc(SPREADER_DETECTOR_INITIAL_SIZE << chunk, sizeof(MeetingLogEntry));
+        if (!entries) return 0;
+        if (!atomic_compare_exchange_strong(&spreader_detector->meeting_log[chunk], &expected, entries)){
+            free(entries);
+            entries = expected;
+        }
+    }
+
+    // person1 has this meeting - checked under the lock of person1's meetings array
+    pthread_mutex_t *lock = &spreader_detector->person_locks[meeting->person_1->slot % SPREADER_DETECTOR_NUM_OF_STRIPES];
+    pthread_mutex_lock(lock);
+    int success = meeting != PersonGetMeetingById(meeting->person_1, meeting->person_2->id) &&
+                  AddMeetingToPerson(meeting->person_1, meeting);
+    pthread_mutex_unlock(lock);
+    if (!success) return 0;
+
+    entries[offset].meeting = meeting;
+    entries[offset].sequence = sequence;
+    return 1;
+}
+
+/**
+ * This function finds the chunk of the concurrent meetings log which holds the given
+ * index (chunk k holds SPREADER_DETECTOR_INITIAL_SIZE * 2^k entries)
+ * @param index the index in the log
+ * @param offset output - the offset of the index inside its chunk
+ * @return the chunk of the index
+ */
+size_t GetLogChunk(size_t index, size_t *offset){
+    unsigned long long blocks = index / SPREADER_DETECTOR_INITIAL_SIZE + 1;
+    size_t chunk = (size_t) (63 - __builtin_clzll(blocks));
+    *offset = index - SPREADER_DETECTOR_INITIAL_SIZE * ((1ULL << chunk) - 1);
+    return chunk;
+}
+
+/**
+ * Moves the meetings added by SpreaderDetectorAddMeetingConcurrent into the meetings of
+ * the spreader detector, and orders them (also in the meetings arrays of the people)
+ * by their sequence. Must be called after all the inserting threads finished.
+ * @param spreader_detector the spreader detector.
+ * @return 1 if the meetings were committed successfully, 0 otherwise.
+ * @if_fails returns 0 (the concurrent meetings stay uncommitted).
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorCommitConcurrentMeetings(SpreaderDetector *spreader_detector){
+    if (!spreader_detector){
+        return 0;
+    }
+    size_t size = atomic_load(&spreader_detector->meeting_log_size);
+    if (size == 0){
+        return 1;
+    }
+    MeetingLogEntry *entries = malloc(size*sizeof(MeetingLogEntry));
+    size_t *cursors = calloc(spreader_detector->people_size + 1, sizeof(size_t));
+    size_t capacity = spreader_detector->meeting_cap == 0 ? SPREADER_DETECTOR_INITIAL_SIZE :
+                      spreader_detector->meeting_cap;
+    while (capacity < spreader_detector->meeting_size + size) {
+        capacity *= SPREADER_DETECTOR_GROWTH_FACTOR;
+    }
+    Meeting **meetings = entries && cursors ?
+                         GrowBulkArray(spreader_detector->meetings, &spreader_detector->meetings_region, &capacity) : NULL;
+    if (!meetings || capacity < spreader_detector->meeting_size + size){
+        free(entries);
+        free(cursors);
+        return 0;
+    }
+    spreader_detector->meetings = meetings;
+    spreader_detector->meeting_cap = capacity;
+
+    size_t num_of_entries = 0;
+    for (size_t i = 0, offset; i < size; ++i) {
+        MeetingLogEntry *chunk = atomic_load(&spreader_detector->meeting_log[GetLogChunk(i, &offset)]);
+        if (chunk && chunk[offset].meeting){
+            entries[num_of_entries++] = chunk[offset];
+        }
+    }
+    size = num_of_entries;
+    qsort(entries, size, sizeof(MeetingLogEntry), CompareLogEntries);
+
+    // the concurrent meetings of each person are the tail of its meetings array -
+    // rewrite each tail in sequence order
+    for (size_t i = 0; i < size; ++i) {
+        cursors[entries[i].meeting->person_1->slot]++;
+    }
+    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
+        cursors[i] = spreader_detector->people[i]->num_of_meetings - cursors[i];
+    }
+    for (size_t i = 0; i < size; ++i) {
+        Person *person = entries[i].meeting->person_1;
+        person->meetings[cursors[person->slot]++] = entries[i].meeting;
+        entries[i].meeting->index = spreader_detector->meeting_size;
+        spreader_detector->meetings[spreader_detector->meeting_size++] = entries[i].meeting;
+        if (spreader_detector->lazy_enabled && !AddIncomingToPerson(entries[i].meeting->person_2, entries[i].meeting)){
+            spreader_detector->lazy_enabled = false;
+        }
+    }
+    spreader_detector->lazy_epoch++;
+
+    for (size_t i = 0; i < SPREADER_DETECTOR_LOG_CHUNKS; ++i) {
+        free(atomic_exchange(&spreader_detector->meeting_log[i], NULL));
+    }
+    atomic_store(&spreader_detector->meeting_log_size, 0);
+    free(entries);
+    free(cursors);
+    return 1;
+}
+
+/**
+ * The function is used to sort the concurrent meetings log by sequence.
+ * @param a pointer to a log entry
+ * @param b pointer to a log entry
+ * @return negative if a should be before b, positive if after, 0 otherwise
+ */
+int CompareLogEntries(const void *a, const void *b){
+    const MeetingLogEntry *entry_1 = a, *entry_2 = b;
+    if (entry_1->sequence < entry_2->sequence){
+        return -1;
+    }
+    return entry_1->sequence != entry_2->sequence;
+}
+
+
 /**
  * This function reads the file of the meeting, parses to file into meetings,
  * and inserts it to the spreader detector.
  * @param spreader_detector the spreader detector we wants to read the meetings into.
  * @param path the path to the meetings file.
+ * @return 1 if the file was read (up to its end, or where reading stopped), 0 otherwise.
+ * @if_fails returns 0 (the file could not be opened, or read / decompressed).
  * @assumption you can assume that the path to the file is ok (and anything but that).
  */
-void SpreaderDetectorReadMeetingsFile(SpreaderDetector *spreader_detector, const char *path){
-    FILE *file = fopen(path, "r"); // open the given file
-    if (!file){ // check the file opened correctly
-        return;
+int SpreaderDetectorReadMeetingsFile(SpreaderDetector *spreader_detector, const char *path){
+    SpreaderAllocPhase phase = SPREADER_ALLOC_SET_PHASE(SPREADER_ALLOC_READ_MEETINGS);
+    InputStream *file = InputStreamOpen(path); // open the given file (plain or compressed)
+    int success = false;
+    if (file){ // check the file opened correctly
+        success = ReadMeetings(spreader_detector, file);
+        InputStreamClose(&file);
     }
+    (void) SPREADER_ALLOC_SET_PHASE(phase);
+    return success;
+}
+
+/**
+ * This function parses the lines of the meetings file into meetings, and inserts them
+ * to the spreader detector (stops at the first malformed line, or meeting which could not be inserted)
+ * @param spreader_detector the spreader detector
+ * @param file the meetings file
+ * @return true if the lines were read up to the end of the file or the stop, false if the
+ * stream failed
+ */
+int ReadMeetings(SpreaderDetector *spreader_detector, InputStream *file){
     char buffer[MAX_LEN_OF_LINE];
-    while (fgets(buffer, MAX_LEN_OF_LINE, file)) {
-        IdT id1, id2;
-        double distance, measure;
-        sscanf(buffer, "%zd %zd %lf %lf", &id1, &id2, &distance, &measure);
-        Person* p1 = GetPersonById(spreader_detector->people, spreader_detector->people_size, id1);
-        Person* p2 = GetPersonById(spreader_detector->people, spreader_detector->people_size, id2);
+    while (InputStreamGetLine(file, buffer, MAX_LEN_OF_LINE)) {
+        MeetingLine line;
+        if (!MeetingLineParse(buffer, MAX_LEN_OF_LINE, &line)){
+            return true;
+        }
+        Person* p1 = SpreaderDetectorGetPersonById(spreader_detector, line.id_1);
+        Person* p2 = SpreaderDetectorGetPersonById(spreader_detector, line.id_2);
         // todo - id doewn't exist - person is null
         // todo - measure and distance - 0? min and max
         // todo - if meeting exist - continue? return?
-        Meeting* meeting = MeetingAlloc(p1, p2, measure, distance); // todo - free
+        Meeting* meeting = MeetingAlloc(p1, p2, line.measure, line.distance); // todo - free
         if (!meeting){
-            fclose(file);
-            return;
+            return true;
         }
 
         if (!SpreaderDetectorAddMeeting(spreader_detector, meeting)){
             MeetingFree(&meeting);
-            fclose(file);
-            return;
+            return true;
         }
     }
+    // the end of the lines - the end of the file, or a read / decompression error
+    return !InputStreamHasError(file);
 }
 
 /**
- * This function search the input id in the input people array, if found it
- * returns the relevant Person
- * @param people array of Person to search in it
- * @param size size of array (pointer)
- * @param id the person id we are looking for
- * @return Person with the input id if exist, otherwise NULL
+ * Returns the person with the given id (a constant time lookup in the id index).
+ * @param spreader_detector the spreader detector contains the person.
+ * @param id the id of the person we are looking for.
+ * @return the person, NULL if no such person exists.
+ * @if_fails returns NULL.
+ * @assumption you can not assume anything.
  */
-Person* GetPersonById(Person** people, size_t size, IdT id){
-    for (size_t i = 0; i < size; ++i) {
-        if (people[i]->id == id){
-            return people[i];
+Person *SpreaderDetectorGetPersonById(SpreaderDetector *spreader_detector, IdT id){
+    if (!spreader_detector || !spreader_detector->id_index){
+        return NULL;
+    }
+    size_t mask = spreader_detector->id_index_cap - 1;
+    for (size_t bucket = HashId(id, spreader_detector->id_index_cap);
+         spreader_detector->id_index[bucket]; bucket = (bucket + 1) & mask) {
+        Person *person = spreader_detector->people[spreader_detector->id_index[bucket] - 1];
+        if (person->id == id){
+            return person;
         }
     }
     return NULL;
 }
 
 /**
- * Returns the infection rate of the person with the given id.
- * @param spreader_detector the spreader detector contains the person.
- * @param id the id of the person we are looking for.
- * @return the infection rate of the person, if not person exists -
- * returns -1.
- * @if_fails returns -1.
- * @assumption you can assume anything.
+ * This function reads the file of the people, parses to file into person objects,
+ * and inserts it to the spreader detector.
+ * @param spreader_detector the spreader detector we wants to read the people into.
+ * @param path the path to the people file.
+ * @return 1 if the file was read (up to its end, or where reading stopped), 0 otherwise.
+ * @if_fails returns 0 (the file could not be opened, or read / decompressed, or out of memory).
+ * @assumption you can assume that the path to the file is ok (and anything but that).
  */
-void SpreaderDetectorReadPeopleFile(SpreaderDetector *spreader_detector, const char *path){
+int SpreaderDetectorReadPeopleFile(SpreaderDetector *spreader_detector, const char *path){
     // todo - detector should be null? otherwise false?
     // todo - if error in line 5 - return spreader with 4? or zero?
-    FILE *file = fopen(path, "r"); // todo - free
-    if (!file){
-        return;
+    SpreaderAllocPhase phase = SPREADER_ALLOC_SET_PHASE(SPREADER_ALLOC_READ_PEOPLE);
+    InputStream *file = InputStreamOpen(path); // plain or compressed
+    int success = false;
+    if (file){
+        success = ReadPeople(spreader_detector, file);
+        InputStreamClose(&file);
     }
+    (void) SPREADER_ALLOC_SET_PHASE(phase);
+    return success;
+}
+
+/**
+ * This function parses the lines of the people file into people, and inserts them
+ * to the spreader detector (stops at the first person who could not be inserted)
+ * @param spreader_detector the spreader detector
+ * @param file the people file
+ * @return true if the lines were read up to the end of the file or the stop, false if the
+ * stream failed or out of memory
+ */
+int ReadPeople(SpreaderDetector *spreader_detector, InputStream *file){
     char buffer[MAX_LEN_OF_LINE];
-    while (fgets(buffer, MAX_LEN_OF_LINE, file)) {
-        char name[MAX_LEN_OF_LINE], sick[6]; // todo - good name?
+    while (InputStreamGetLine(file, buffer, MAX_LEN_OF_LINE)) {
+        char name[MAX_LEN_OF_LINE], sick[MAX_LEN_OF_LINE] = ""; // todo - good name?
         IdT id;
         size_t age;
         sscanf(buffer, "%s %zd %zd %s", name, &id, &age, sick);
-        char * pName = malloc(strlen(name)-1); // todo - free
+        char * pName = malloc(strlen(name)+1); // todo - free
         if (!pName){
-            fclose(file);
-            return;
+            return false;
         }
         strcpy(pName, name); // todo - needed?
         int sickVal = strcmp(sick, "SICK")==0 ? 1 : 0;
         Person* person = PersonAlloc(id, pName, age, sickVal); // todo - free
         if (!person){
             free(pName);
-            fclose(file);
-            return;
+            return false;
         }
         if (!SpreaderDetectorAddPerson(spreader_detector, person)){
             PersonFree(&person);
-            fclose(file);
-            return;
+            return true;
         }
     }
+    return !InputStreamHasError(file);
 }
 
 /**
@@ -261,113 +714,1446 @@ void SpreaderDetectorReadPeopleFile(SpreaderDetector *spreader_detector, const c
  * @assumption you can assume anything.
  */
 double SpreaderDetectorGetInfectionRateById(SpreaderDetector *spreader_detector, IdT id){
-    if (!spreader_detector || !spreader_detector->people){
+    double rate;
+    SpreaderDetectorGetInfectionRatesByIds(spreader_detector, &id, 1, &rate);
+    return rate;
+}
+
+/**
+ * Returns the infection rate of the person with the given id, calculated on demand without
+ * SpreaderDetectorCalculateInfectionChances: walks back over the meetings the person was met in
+ * (and the meetings those people were met in, and so on) up to the sick people, and memoizes
+ * the rate of every person on the way until the people, the meetings or the policy change.
+ * The rate is the rate SpreaderDetectorCalculateInfectionChances calculates (whatever was
+ * queried before).
+ * The first call keeps the incoming meetings of all the people (one pass over the meetings),
+ * and later insertions keep them up to date.
+ * Must not be called together with any function which changes the spreader detector,
+ * nor with another call of this function.
+ * @param spreader_detector the spreader detector contains the person.
+ * @param id the id of the person we are looking for.
+ * @return the infection rate of the person, if not person exists -
+ * returns -1.
+ * @if_fails returns -1.
+ * @assumption you can not assume anything.
+ */
+double SpreaderDetectorGetLazyInfectionRateById(SpreaderDetector *spreader_detector, IdT id){
+    Person *person = SpreaderDetectorGetPersonById(spreader_detector, id);
+    if (!person || !UpdatePolicyColumns(spreader_detector)){
         return -1;
     }
-    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
-        if (spreader_detector->people[i]->id == id){
-            return spreader_detector->people[i]->infection_rate;
-        }
+    if (!spreader_detector->lazy_enabled && !BuildIncomingMeetings(spreader_detector)){
+        return -1;
     }
-    return -1;
+    if (spreader_detector->lazy_rates_cap < spreader_detector->people_size){
+        LazyRate *temp = realloc(spreader_detector->lazy_rates, spreader_detector->people_cap*sizeof(LazyRate));
+        if (!temp) return -1;
+        // epoch 0 is never current
+        memset(temp + spreader_detector->lazy_rates_cap, 0,
+               (spreader_detector->people_cap - spreader_detector->lazy_rates_cap)*sizeof(LazyRate));
+        spreader_detector->lazy_rates = temp;
+        spreader_detector->lazy_rates_cap = spreader_detector->people_cap;
+    }
+    if (!EvaluateLazyRate(spreader_detector, person->slot)){
+        return -1;
+    }
+    return spreader_detector->lazy_rates[person->slot].rate;
 }
 
-
-
 /**
- * This function runs the algorithm which calculates the infection rates of the people.
- * When this algorithm ends, the user should be able to use the function
- * SpreaderDetectorGetInfectionRateById and get the infection rate of each person.
- * @param spreader_detector a spreader_detector.
- * @assumption you can not assume anything.
+ * This function (re)builds the incoming meetings of all the people, and keeps them
+ * up to date from now on
+ * @param spreader_detector the spreader detector
+ * @return true on success, false otherwise
  */
-void SpreaderDetectorCalculateInfectionChances(SpreaderDetector *spreader_detector){
+int BuildIncomingMeetings(SpreaderDetector *spreader_detector){
     for (size_t i = 0; i < spreader_detector->people_size; ++i) {
-        if (spreader_detector->people[i]->is_sick){
-            UpdateRate(spreader_detector->people[i]);
-            return;
-        }
+        spreader_detector->people[i]->num_of_incoming = 0;
     }
+    for (size_t i = 0; i < spreader_detector->meeting_size; ++i) {
+        Meeting *meeting = spreader_detector->meetings[i];
+        if (!AddIncomingToPerson(meeting->person_2, meeting)) return false;
+    }
+    spreader_detector->lazy_enabled = true;
+    return true;
 }
 
 /**
- * This function goes recursively over the meetings of each person (start from
- * the sick one) and update their infection rate
- * @param root
+ * This function memoizes the lazy rate of the given slot, and of every person it depends on which
+ * was not memoized in the current epoch: collects the people who met the person (and the people who
+ * met them, and so on - up to the memoized people, which enter the people they met), and propagates
+ * over them as SpreaderDetectorCalculateInfectionChances does. Each of them is then final - everyone
+ * he/she depends on (the whole cycle of meetings included) was collected
+ * @param spreader_detector the spreader detector (with the incoming meetings and the policy columns)
+ * @param slot the slot
+ * @return true on success, false otherwise (nothing is memoized then)
  */
-void UpdateRate(Person* root){
-    if (!root || !root->meetings){
-        return;
+int EvaluateLazyRate(SpreaderDetector *spreader_detector, size_t slot){
+    LazyRate *memo = spreader_detector->lazy_rates;
+    size_t lazy_epoch = spreader_detector->lazy_epoch, size = 0;
+    if (memo[slot].epoch == lazy_epoch){
+        return true;
+    }
+    if (!ReservePropagationScratch(spreader_detector) || !PushLazySlot(spreader_detector, &size, slot)){
+        return false;
     }
-    for (size_t i = 0; i < root->num_of_meetings; ++i) {
-        CalcCrna(root, root->meetings[i]->person_2, root->meetings[i]->measure, root->meetings[i]->distance);
-        UpdateRate(root->meetings[i]->person_2);
+    PropagationMark *marks = spreader_detector->propagation_marks;
+    size_t epoch = ++spreader_detector->propagation_epoch;
+    StampPropagationMark(spreader_detector, slot, epoch);
+    for (size_t i = 0; i < size; ++i) {
+        size_t current = spreader_detector->lazy_stack[i];
+        const Person *person = spreader_detector->people[current];
+        for (size_t j = 0; j < person->num_of_incoming; ++j) {
+            const Meeting *meeting = person->incoming[j];
+            size_t from = meeting->person_1->slot;
+            if (memo[from].epoch == lazy_epoch){
+                if (memo[from].state == LAZY_RATE_REACHED){
+                    double rate = CalcCrna(meeting, spreader_detector->meeting_weights,
+                                           spreader_detector->person_additions, memo[from].rate);
+                    marks[current].rate = rate > marks[current].rate ? rate : marks[current].rate;
+                    marks[current].flags |= PROPAGATION_MARK_ENTERED;
+                }
+            }
+            else if (marks[from].epoch != epoch){
+                if (!PushLazySlot(spreader_detector, &size, from)) return false;
+                StampPropagationMark(spreader_detector, from, epoch);
+            }
+        }
+    }
+    PropagateReached(spreader_detector, spreader_detector->lazy_stack, size, epoch, true, 0, NULL);
+    for (size_t i = 0; i < size; ++i) {
+        size_t current = spreader_detector->lazy_stack[i];
+        memo[current].rate = marks[current].rate;
+        memo[current].epoch = lazy_epoch;
+        memo[current].state = marks[current].flags & PROPAGATION_MARK_DONE ? LAZY_RATE_REACHED : LAZY_RATE_UNREACHED;
     }
+    return true;
 }
 
 /**
- * This function calculates the Crna of person2 according to the formula in the exercise.
- * @param person1 the person with the updated infection rate
- * @param person2 the person we need to update his infection rate
- * @param measure the measure of their meeting
- * @param distance the distance in their meeting
+ * This function appends a slot to the lazy stack
+ * @param spreader_detector the spreader detector
+ * @param size the size of the stack
+ * @param slot the slot
+ * @return true on success, false otherwise
  */
-void CalcCrna(Person* person1, Person* person2, double measure, double distance){
-    // todo - meeting distance == 0??
-    person2->infection_rate = person1->infection_rate * ((measure*MIN_DISTANCE)/(distance*MAX_MEASURE));
-    if (person2->age > AGE_THRESHOLD){
-        person2->infection_rate += INFECTION_RATE_ADDITION_DUE_TO_AGE;
-    }
-    if (person2->infection_rate > 1){
-        person2->infection_rate = 1;
+int PushLazySlot(SpreaderDetector *spreader_detector, size_t *size, size_t slot){
+    if (*size == spreader_detector->lazy_stack_cap){
+        size_t capacity = spreader_detector->lazy_stack_cap == 0 ? SPREADER_DETECTOR_INITIAL_SIZE :
+                          spreader_detector->lazy_stack_cap * SPREADER_DETECTOR_GROWTH_FACTOR;
+        size_t *temp = realloc(spreader_detector->lazy_stack, capacity*sizeof(size_t));
+        if (!temp) return false;
+        spreader_detector->lazy_stack = temp;
+        spreader_detector->lazy_stack_cap = capacity;
     }
+    spreader_detector->lazy_stack[(*size)++] = slot;
+    return true;
 }
 
 /**
- * Gets the recommendation for treatment for all people based on the parameters above,
- * and prints it to the given file path.
+ * Finds the people within k meetings of the person with the given id (not including him/her),
+ * with a breadth first search bounded by k, following the meetings in the given direction.
+ * A meeting followed against its direction uses the same weight (and the age addition of the
+ * person reached). The visited state is epoch stamped and kept in the spreader detector, so a
+ * query allocates nothing (once the scratch and the output are large enough) and clears nothing.
+ * Not thread safe - the queries share the scratch of the spreader detector.
  * @param spreader_detector the spreader detector contains the person.
- * @param file_path the path to the output file.
- * @return returns 1 if printed successfully, 0 otherwise.
- * @if_fails return 0.
- * @assumption you can assume that the path to the file is ok (and anything but that).
+ * @param id the id of the center of the neighborhood.
+ * @param k the maximal number of meetings from the center.
+ * @param direction the meetings to follow.
+ * @param neighborhood output - the people, by increasing hops (its previous content is dropped).
+ * @return 1 on success, 0 otherwise.
+ * @if_fails returns 0 (no such person, or out of memory - the neighborhood is then empty).
+ * @assumption you can not assume anything.
  */
-int SpreaderDetectorPrintRecommendTreatmentToAll(SpreaderDetector *spreader_detector, const char *file_path){
-    FILE *file = fopen(file_path, "w"); // todo - free
-    if (!file){
+int SpreaderDetectorNeighborhood(SpreaderDetector *spreader_detector, IdT id, size_t k,
+                                 SpreaderDirection direction, SpreaderNeighborhood *neighborhood){
+    if (!neighborhood){
         return 0;
     }
-    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
-        if (spreader_detector->people[i]->infection_rate > MEDICAL_SUPERVISION_THRESHOLD){
-            fprintf(file, MEDICAL_SUPERVISION_THRESHOLD_MSG, spreader_detector->people[i]->name,
-                    spreader_detector->people[i]->id, spreader_detector->people[i]->age, spreader_detector->people[i]->infection_rate);
-        }
-        else if (spreader_detector->people[i]->infection_rate > REGULAR_QUARANTINE_THRESHOLD){
-            fprintf(file, REGULAR_QUARANTINE_MSG, spreader_detector->people[i]->name,
-                    spreader_detector->people[i]->id, spreader_detector->people[i]->age, spreader_detector->people[i]->infection_rate);
-        }
-        else {
-            fprintf(file, CLEAN_MSG, spreader_detector->people[i]->name,
-                    spreader_detector->people[i]->id, spreader_detector->people[i]->age, spreader_detector->people[i]->infection_rate);
+    neighborhood->size = 0;
+    Person *center = SpreaderDetectorGetPersonById(spreader_detector, id);
+    if (!center || !(direction & SPREADER_DIRECTION_BOTH) || !UpdatePolicyColumns(spreader_detector) ||
+        !ReserveNeighborhoodScratch(spreader_detector)){
+        return 0;
+    }
+    if ((direction & SPREADER_DIRECTION_IN) && !spreader_detector->lazy_enabled &&
+        !BuildIncomingMeetings(spreader_detector)){
+        return 0;
+    }
+    size_t epoch = ++spreader_detector->neighborhood_epoch;
+    spreader_detector->neighborhood_marks[center->slot] = (NeighborhoodMark) {epoch, SIZE_MAX, 0, 0};
+    spreader_detector->neighborhood_queue[0] = (NeighborhoodStep) {center->slot, 1};
+    size_t size = 1;
+    // hop by hop: a person is queued when the hop found him/her, or a better rate for him/her
+    for (size_t hops = 1; hops <= k && size > 0; ++hops) {
+        size_t next_size = 0;
+        for (size_t i = 0; i < size; ++i) {
+            NeighborhoodStep step = spreader_detector->neighborhood_queue[i];
+            Person *person = spreader_detector->people[step.slot];
+            for (size_t j = 0; (direction & SPREADER_DIRECTION_OUT) && j < person->num_of_meetings; ++j) {
+                if (!VisitNeighbor(spreader_detector, person->meetings[j]->person_2, person->meetings[j],
+                                   step.rate, hops, neighborhood, &next_size)){
+                    neighborhood->size = 0;
+                    return 0;
+                }
+            }
+            for (size_t j = 0; (direction & SPREADER_DIRECTION_IN) && j < person->num_of_incoming; ++j) {
+                if (!VisitNeighbor(spreader_detector, person->incoming[j]->person_1, person->incoming[j],
+                                   step.rate, hops, neighborhood, &next_size)){
+                    neighborhood->size = 0;
+                    return 0;
+                }
+            }
         }
+        NeighborhoodStep *queue = spreader_detector->neighborhood_queue;
+        spreader_detector->neighborhood_queue = spreader_detector->neighborhood_next;
+        spreader_detector->neighborhood_next = queue;
+        size = next_size;
     }
-    fclose(file);
     return 1;
 }
 
-
-size_t SpreaderDetectorGetNumOfPeople(SpreaderDetector *spreader_detector){
-    if (!spreader_detector){
-        return 0;
+/**
+ * This function grows the visited marks and the queues of SpreaderDetectorNeighborhood to the
+ * capacity of the people array (the new marks are of no query)
+ * @param spreader_detector the spreader detector
+ * @return true on success, false otherwise
+ */
+int ReserveNeighborhoodScratch(SpreaderDetector *spreader_detector){
+    size_t capacity = spreader_detector->people_cap;
+    if (spreader_detector->neighborhood_marks_cap < spreader_detector->people_size){
+        NeighborhoodMark *marks = realloc(spreader_detector->neighborhood_marks, capacity*sizeof(NeighborhoodMark));
+        if (!marks) return false;
+        memset(marks + spreader_detector->neighborhood_marks_cap, 0,
+               (capacity - spreader_detector->neighborhood_marks_cap)*sizeof(NeighborhoodMark));
+        spreader_detector->neighborhood_marks = marks;
+        spreader_detector->neighborhood_marks_cap = capacity;
     }
-    return spreader_detector->people_size;
+    // a person is queued at most once per hop
+    if (spreader_detector->neighborhood_queue_cap < spreader_detector->people_size){
+        NeighborhoodStep *queue = realloc(spreader_detector->neighborhood_queue, capacity*sizeof(NeighborhoodStep));
+        if (!queue) return false;
+        spreader_detector->neighborhood_queue = queue;
+        NeighborhoodStep *next = realloc(spreader_detector->neighborhood_next, capacity*sizeof(NeighborhoodStep));
+        if (!next) return false;
+        spreader_detector->neighborhood_next = next;
+        spreader_detector->neighborhood_queue_cap = capacity;
+    }
+    return true;
+}
 
+/**
+ * This function reaches a person through a meeting: adds him/her to the neighborhood the first
+ * time, and queues him/her for the next hop whenever the meeting gives him/her a better rate
+ * @param spreader_detector the spreader detector
+ * @param person the person reached
+ * @param meeting the meeting
+ * @param rate the rate of the other person of the meeting
+ * @param hops the number of meetings from the center to the person through the meeting
+ * @param neighborhood the neighborhood
+ * @param next_size the size of the queue of the next hop
+ * @return true on success, false if the neighborhood could not grow
+ */
+int VisitNeighbor(SpreaderDetector *spreader_detector, Person *person, const Meeting *meeting, double rate,
+                  size_t hops, SpreaderNeighborhood *neighborhood, size_t *next_size){
+    NeighborhoodMark *mark = &spreader_detector->neighborhood_marks[person->slot];
+    double candidate = rate * spreader_detector->meeting_weights[meeting->index] +
+                       spreader_detector->person_additions[person->slot];
+    candidate = candidate > 1 ? 1 : candidate;
+    if (mark->epoch != spreader_detector->neighborhood_epoch){
+        if (neighborhood->size == neighborhood->capacity){
+            size_t capacity = neighborhood->capacity == 0 ? SPREADER_DETECTOR_INITIAL_SIZE :
+                              neighborhood->capacity * SPREADER_DETECTOR_GROWTH_FACTOR;
+            SpreaderNeighbor *temp = realloc(neighborhood->neighbors, capacity*sizeof(SpreaderNeighbor));
+            if (!temp) return false;
+            neighborhood->neighbors = temp;
+            neighborhood->capacity = capacity;
+        }
+        neighborhood->neighbors[neighborhood->size] = (SpreaderNeighbor) {person, hops, candidate};
+        *mark = (NeighborhoodMark) {spreader_detector->neighborhood_epoch, neighborhood->size++, 0, 0};
+    }
+    else if (mark->index == SIZE_MAX || candidate <= neighborhood->neighbors[mark->index].rate){
+        return true; // the center, or no better rate
+    }
+    else {
+        neighborhood->neighbors[mark->index].rate = candidate;
+    }
+    if (mark->queued == hops){
+        spreader_detector->neighborhood_next[mark->position].rate = candidate;
+    }
+    else {
+        mark->queued = hops;
+        mark->position = (*next_size)++;
+        spreader_detector->neighborhood_next[mark->position] = (NeighborhoodStep) {person->slot, candidate};
+    }
+    return true;
 }
 
+/**
+ * Frees the people array of the given neighborhood (the neighborhood itself is not freed).
+ * @param neighborhood the neighborhood.
+ * @assumption you can not assume anything.
+ */
+void SpreaderNeighborhoodFree(SpreaderNeighborhood *neighborhood){
+    if (!neighborhood){
+        return;
+    }
+    free(neighborhood->neighbors);
+    neighborhood->neighbors = NULL;
+    neighborhood->size = 0;
+    neighborhood->capacity = 0;
+}
 
-size_t SpreaderDetectorGetNumOfMeetings(SpreaderDetector *spreader_detector){
-    if (!spreader_detector){
+/**
+ * Returns the infection rates of the people with the given ids, all from the same generation.
+ * @param spreader_detector the spreader detector contains the people.
+ * @param ids the ids of the people.
+ * @param num_of_ids the number of ids.
+ * @param rates output - the rate of each id (-1 if no such person).
+ * @return the generation of the rates (0 if no calculation was published yet -
+ * the rates are then the initial rates).
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+size_t SpreaderDetectorGetInfectionRatesByIds(SpreaderDetector *spreader_detector, const IdT *ids,
+                                              size_t num_of_ids, double *rates){
+    if (!ids || !rates){
         return 0;
     }
-    return spreader_detector->meeting_size;
+    const RateSnapshot *snapshot = SpreaderDetectorAcquireRates(spreader_detector);
+    for (size_t i = 0; i < num_of_ids; ++i) {
+        Person *person = SpreaderDetectorGetPersonById(spreader_detector, ids[i]);
+        if (!person){
+            rates[i] = -1;
+        }
+        else {
+            // people added after the snapshot still have their initial rate (see PersonAlloc) -
+            // infection_rate itself is written by PublishBackBuffer, so it is not read here
+            rates[i] = snapshot && person->slot < snapshot->size ? snapshot->rates[person->slot] :
+                       (person->is_sick ? 1 : 0);
+        }
+    }
+    size_t generation = snapshot ? snapshot->generation : 0;
+    SpreaderDetectorReleaseRates(spreader_detector, snapshot);
+    return generation;
+}
+
+/**
+ * Pins the last published generation of infection rates, so it is not overwritten
+ * by the next calculation until SpreaderDetectorReleaseRates is called.
+ * Lock free - may be called from other threads while SpreaderDetectorCalculateInfectionChances runs.
+ * @param spreader_detector the spreader detector.
+ * @return the snapshot (rates by slot), NULL if no calculation was published yet.
+ * @assumption you can not assume anything.
+ */
+const RateSnapshot *SpreaderDetectorAcquireRates(SpreaderDetector *spreader_detector){
+    if (!spreader_detector){
+        return NULL;
+    }
+    while (true) {
+        size_t front = atomic_load(&spreader_detector->rate_front);
+        if (front == SPREADER_DETECTOR_NO_SNAPSHOT){
+            return NULL;
+        }
+        // announce the read, then make sure the buffer is still the front - otherwise
+        // the writer may already be reusing it
+        atomic_fetch_add(&spreader_detector->rate_readers[front], 1);
+        if (atomic_load(&spreader_detector->rate_front) == front){
+            return &spreader_detector->rate_snapshots[front];
+        }
+        atomic_fetch_sub(&spreader_detector->rate_readers[front], 1);
+    }
+}
+
+/**
+ * Releases a snapshot returned by SpreaderDetectorAcquireRates.
+ * @param spreader_detector the spreader detector.
+ * @param snapshot the snapshot (may be NULL).
+ */
+void SpreaderDetectorReleaseRates(SpreaderDetector *spreader_detector, const RateSnapshot *snapshot){
+    if (!spreader_detector || !snapshot){
+        return;
+    }
+    atomic_fetch_sub(&spreader_detector->rate_readers[snapshot - spreader_detector->rate_snapshots], 1);
+}
+
+/**
+ * This function returns the buffer which is not published, once no reader is inside it,
+ * with room for all the people and filled with their current rates
+ * @param spreader_detector the spreader detector
+ * @return the back buffer, NULL if it could not be allocated
+ */
+RateSnapshot *PrepareBackBuffer(SpreaderDetector *spreader_detector){
+    size_t front = atomic_load(&spreader_detector->rate_front);
+    size_t back = front == 0 ? 1 : 0;
+    // readers which saw this buffer as the front leave it right away
+    while (atomic_load(&spreader_detector->rate_readers[back]) != 0) {
+        sched_yield();
+    }
+    RateSnapshot *snapshot = &spreader_detector->rate_snapshots[back];
+    if (snapshot->capacity < spreader_detector->people_size){
+        double *rates = realloc(snapshot->rates, spreader_detector->people_size*sizeof(double));
+        if (!rates) return NULL;
+        snapshot->rates = rates;
+        snapshot->capacity = spreader_detector->people_size;
+    }
+    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
+        snapshot->rates[i] = spreader_detector->people[i]->infection_rate;
+    }
+    snapshot->size = spreader_detector->people_size;
+    return snapshot;
+}
+
+/**
+ * This function publishes the back buffer with a single atomic store, and then copies
+ * the rates to the people (for the functions which read the people directly)
+ * @param spreader_detector the spreader detector
+ * @param back the back buffer
+ */
+void PublishBackBuffer(SpreaderDetector *spreader_detector, RateSnapshot *back){
+    back->generation = ++spreader_detector->rate_generation;
+    atomic_store(&spreader_detector->rate_front, (size_t) (back - spreader_detector->rate_snapshots));
+    for (size_t i = 0; i < back->size; ++i) {
+        spreader_detector->people[i]->infection_rate = back->rates[i];
+    }
+}
+
+
+
+/**
+ * This function runs the algorithm which calculates the infection rates of the people.
+ * When this algorithm ends, the user should be able to use the function
+ * SpreaderDetectorGetInfectionRateById and get the infection rate of each person.
+ * @param spreader_detector a spreader_detector.
+ * @assumption you can not assume anything.
+ */
+void SpreaderDetectorCalculateInfectionChances(SpreaderDetector *spreader_detector){
+    if (!spreader_detector || !spreader_detector->people){
+        return;
+    }
+    SpreaderAllocPhase phase = SPREADER_ALLOC_SET_PHASE(SPREADER_ALLOC_CALCULATE);
+    CalculateInfectionChances(spreader_detector);
+    (void) SPREADER_ALLOC_SET_PHASE(phase);
+}
+
+/**
+ * Publishes infection rates calculated outside of the spreader detector (e.g. by SpreaderExternalCalculate)
+ * as a new generation, the same way SpreaderDetectorCalculateInfectionChances publishes its rates.
+ * @param spreader_detector the spreader detector.
+ * @param rates the infection rate of each person, by slot (people_size entries).
+ * @return 1 if the rates were published successfully, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorPublishInfectionRates(SpreaderDetector *spreader_detector, const double *rates){
+    if (!spreader_detector || !rates){
+        return 0;
+    }
+    RateSnapshot *back = PrepareBackBuffer(spreader_detector);
+    if (!back){
+        return 0;
+    }
+    memcpy(back->rates, rates, back->size*sizeof(double));
+    PublishBackBuffer(spreader_detector, back);
+    return 1;
+}
+
+/**
+ * Calculates the infection rates as SpreaderDetectorCalculateInfectionChances does, when some of
+ * the people are also met from outside the spreader detector (e.g. by the people of another shard):
+ * a person with an entry rate was met from outside with that rate (the highest of those meetings),
+ * and is calculated as a person met from outside his/her cycle. Nothing is published, and the
+ * people do not change.
+ * @param spreader_detector the spreader detector.
+ * @param entry_rates the entry rate of each person, by slot (negative - not met from outside).
+ * @param rates output - the infection rate of each person, by slot (people_size entries).
+ * @return 1 if the rates were calculated successfully, 0 otherwise.
+ * @if_fails returns 0 (out of memory).
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorCalculateEnteredRates(SpreaderDetector *spreader_detector, const double *entry_rates, double *rates){
+    if (!spreader_detector || !entry_rates || !rates){
+        return 0;
+    }
+    size_t size = spreader_detector->people_size;
+    size_t *starts = malloc((size + 1)*sizeof(size_t));
+    if (!starts || !UpdatePolicyColumns(spreader_detector) || !ReservePropagationScratch(spreader_detector)){
+        free(starts);
+        return 0;
+    }
+    PropagationMark *marks = spreader_detector->propagation_marks;
+    size_t epoch = ++spreader_detector->propagation_epoch;
+    for (size_t i = 0; i < size; ++i) {
+        StampPropagationMark(spreader_detector, i, epoch);
+        if (entry_rates[i] >= 0){
+            marks[i].rate = entry_rates[i] > marks[i].rate ? entry_rates[i] : marks[i].rate;
+            marks[i].flags |= PROPAGATION_MARK_ENTERED;
+        }
+        rates[i] = marks[i].rate;
+        starts[i] = i;
+    }
+    // every person is stamped - the propagation starts from the sick and the entered ones
+    PropagateReached(spreader_detector, starts, size, epoch, true, 0, rates);
+    free(starts);
+    return 1;
+}
+
+/**
+ * This function calculates the infection rates into the back buffer, and publishes it
+ * @param spreader_detector the spreader detector (with people)
+ */
+void CalculateInfectionChances(SpreaderDetector *spreader_detector){
+    if (!UpdatePolicyColumns(spreader_detector) || !SpreaderDetectorLabelComponents(spreader_detector) ||
+        !ReservePropagationScratch(spreader_detector)){
+        return;
+    }
+    size_t num_of_components = spreader_detector->num_of_components;
+    RateSnapshot *back = PrepareBackBuffer(spreader_detector);
+    if (!back){
+        return;
+    }
+    PropagationTasks tasks = {.spreader_detector = spreader_detector, .rates = back->rates};
+    tasks.tasks = malloc((num_of_components + 1)*sizeof(SpreaderComponent *));
+    tasks.sick_start = calloc(num_of_components + 1, sizeof(size_t));
+    tasks.sick_slots = malloc((spreader_detector->people_size + 1)*sizeof(size_t));
+    tasks.offsets = malloc((num_of_components + 1)*sizeof(size_t));
+    size_t *cursors = malloc((num_of_components + 1)*sizeof(size_t));
+    if (!tasks.tasks || !tasks.sick_start || !tasks.sick_slots || !tasks.offsets || !cursors){
+        free(tasks.tasks);
+        free(tasks.sick_start);
+        free(tasks.sick_slots);
+        free(tasks.offsets);
+        free(cursors);
+        return;
+    }
+    tasks.epoch = ++spreader_detector->propagation_epoch;
+
+    // only the components with a sick person are tasks, the rest keep their default rates
+    for (size_t c = 0, offset = 0; c < num_of_components; ++c) {
+        tasks.sick_start[c + 1] = tasks.sick_start[c] + spreader_detector->components[c].sick_count;
+        tasks.offsets[c] = offset;
+        offset += spreader_detector->components[c].size;
+        cursors[c] = tasks.sick_start[c];
+        if (spreader_detector->components[c].sick_count > 0){
+            tasks.tasks[tasks.num_of_tasks++] = &spreader_detector->components[c];
+        }
+    }
+    qsort(tasks.tasks, tasks.num_of_tasks, sizeof(SpreaderComponent *), CompareComponentsBySize);
+    // group the sick people by component
+    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
+        size_t slot = spreader_detector->file_order ? spreader_detector->file_order[i] : i;
+        if (spreader_detector->people[slot]->is_sick){
+            tasks.sick_slots[cursors[spreader_detector->component_of[slot]]++] = slot;
+        }
+    }
+    free(cursors);
+
+    // the components are disjoint, so each thread owns the people of the components it takes
+    atomic_init(&tasks.next, 0);
+    pthread_t threads[SPREADER_DETECTOR_MAX_THREADS];
+    size_t num_of_threads = GetNumOfThreads(tasks.num_of_tasks), started = 0;
+    while (started + 1 < num_of_threads &&
+           pthread_create(&threads[started], NULL, PropagateComponents, &tasks) == 0) {
+        started++;
+    }
+    PropagateComponents(&tasks);
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    SpreaderComponent *components = spreader_detector->components;
+    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
+        SpreaderComponent *component = &components[spreader_detector->component_of[i]];
+        if (back->rates[i] > component->max_rate){
+            component->max_rate = back->rates[i];
+        }
+    }
+    PublishBackBuffer(spreader_detector, back);
+    free(tasks.tasks);
+    free(tasks.sick_start);
+    free(tasks.sick_slots);
+    free(tasks.offsets);
+}
+
+/**
+ * The propagation thread - takes components until none is left, and propagates
+ * the infection rates from the sick people of the component
+ * @param arg the tasks (PropagationTasks *)
+ * @return NULL
+ */
+void *PropagateComponents(void *arg){
+    PropagationTasks *tasks = arg;
+    size_t task;
+    while ((task = atomic_fetch_add(&tasks->next, 1)) < tasks->num_of_tasks) {
+        size_t c = (size_t) (tasks->tasks[task] - tasks->spreader_detector->components);
+        PropagateReached(tasks->spreader_detector, tasks->sick_slots + tasks->sick_start[c],
+                         tasks->sick_start[c + 1] - tasks->sick_start[c], tasks->epoch, false,
+                         tasks->offsets[c], tasks->rates);
+    }
+    return NULL;
+}
+
+/**
+ * This function returns the number of threads that should propagate the given
+ * number of tasks (bounded by the number of cores and SPREADER_DETECTOR_MAX_THREADS)
+ * @param num_of_tasks the number of tasks
+ * @return the number of threads (at least 1)
+ */
+size_t GetNumOfThreads(size_t num_of_tasks){
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t num_of_threads = cores > 0 ? (size_t) cores : 1;
+    if (num_of_threads > SPREADER_DETECTOR_MAX_THREADS){
+        num_of_threads = SPREADER_DETECTOR_MAX_THREADS;
+    }
+    if (num_of_threads > num_of_tasks){
+        num_of_threads = num_of_tasks;
+    }
+    return num_of_threads ? num_of_threads : 1;
+}
+
+/**
+ * Labels the connected components of the meetings graph with union-find.
+ * Components are numbered by the order of their first person in the people array.
+ * Called by SpreaderDetectorCalculateInfectionChances, which propagates each
+ * component holding a sick person as an independent task and skips the rest.
+ * @param spreader_detector a spreader_detector.
+ * @return 1 if the components were labeled successfully, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorLabelComponents(SpreaderDetector *spreader_detector){
+    if (!spreader_detector){
+        return 0;
+    }
+    spreader_detector->labeled_size = 0;
+    size_t size = spreader_detector->people_size;
+    size_t *parents = malloc((size + 1)*sizeof(size_t));
+    size_t *component_of = realloc(spreader_detector->component_of, (size + 1)*sizeof(size_t));
+    if (!parents || !component_of){
+        free(parents);
+        if (component_of) spreader_detector->component_of = component_of;
+        return 0;
+    }
+    spreader_detector->component_of = component_of;
+
+    // union by smaller slot - keeps each root the first person of its component
+    for (size_t i = 0; i < size; ++i) {
+        parents[i] = i;
+    }
+    for (size_t i = 0; i < spreader_detector->meeting_size; ++i) {
+        size_t root_1 = FindRoot(parents, spreader_detector->meetings[i]->person_1->slot);
+        size_t root_2 = FindRoot(parents, spreader_detector->meetings[i]->person_2->slot);
+        if (root_1 < root_2){
+            parents[root_2] = root_1;
+        }
+        else {
+            parents[root_1] = root_2;
+        }
+    }
+
+    size_t num_of_components = 0;
+    for (size_t i = 0; i < size; ++i) {
+        size_t root = FindRoot(parents, i);
+        // roots come before the rest of their component, so their label is already set
+        component_of[i] = root == i ? num_of_components++ : component_of[root];
+    }
+    free(parents);
+
+    SpreaderComponent *components = realloc(spreader_detector->components,
+                                            (num_of_components + 1)*sizeof(SpreaderComponent));
+    if (!components){
+        return 0;
+    }
+    spreader_detector->components = components;
+    spreader_detector->num_of_components = num_of_components;
+    spreader_detector->labeled_size = size;
+    memset(components, 0, num_of_components*sizeof(SpreaderComponent));
+    for (size_t i = 0; i < size; ++i) {
+        SpreaderComponent *component = &components[component_of[i]];
+        if (component->size++ == 0){
+            component->first_slot = i;
+        }
+        component->sick_count += spreader_detector->people[i]->is_sick != 0;
+        if (spreader_detector->people[i]->infection_rate > component->max_rate){
+            component->max_rate = spreader_detector->people[i]->infection_rate;
+        }
+    }
+    return 1;
+}
+
+/**
+ * This function finds the root of the given slot, halving the path on the way
+ * @param parents the union-find parents array
+ * @param slot the slot to find its root
+ * @return the root of the slot
+ */
+size_t FindRoot(size_t *parents, size_t slot){
+    while (parents[slot] != slot) {
+        parents[slot] = parents[parents[slot]];
+        slot = parents[slot];
+    }
+    return slot;
+}
+
+/**
+ * The function is used to sort the propagation tasks, largest component first
+ * (so a large component is not the last one to start).
+ * @param a pointer to a component pointer
+ * @param b pointer to a component pointer
+ * @return negative if a should be before b, positive if after, 0 otherwise
+ */
+int CompareComponentsBySize(const void *a, const void *b){
+    const SpreaderComponent *component_1 = *(SpreaderComponent * const *) a;
+    const SpreaderComponent *component_2 = *(SpreaderComponent * const *) b;
+    if (component_1->size > component_2->size){
+        return -1;
+    }
+    return component_1->size != component_2->size;
+}
+
+/**
+ * Returns the statistics of the connected components (size, sick count, max rate),
+ * as labeled by the last call to SpreaderDetectorLabelComponents.
+ * @param spreader_detector the spreader detector object.
+ * @param num_of_components output - the number of components.
+ * @return the components array (owned by the spreader detector).
+ * @if_fails returns NULL and sets *num_of_components to 0.
+ * @assumption you can not assume anything.
+ */
+const SpreaderComponent *SpreaderDetectorGetComponents(SpreaderDetector *spreader_detector,
+                                                       size_t *num_of_components){
+    if (!num_of_components){
+        return NULL;
+    }
+    if (!spreader_detector || !spreader_detector->components){
+        *num_of_components = 0;
+        return NULL;
+    }
+    *num_of_components = spreader_detector->num_of_components;
+    return spreader_detector->components;
+}
+
+/**
+ * Returns the statistics of the component of the person with the given id.
+ * @param spreader_detector the spreader detector contains the person.
+ * @param id the id of the person we are looking for.
+ * @return the component of the person.
+ * @if_fails returns NULL (no such person, or the components are not labeled).
+ * @assumption you can not assume anything.
+ */
+const SpreaderComponent *SpreaderDetectorGetComponentById(SpreaderDetector *spreader_detector, IdT id){
+    if (!spreader_detector || !spreader_detector->components){
+        return NULL;
+    }
+    Person *person = SpreaderDetectorGetPersonById(spreader_detector, id);
+    // people added after the labeling have no component yet
+    if (!person || person->slot >= spreader_detector->labeled_size){
+        return NULL;
+    }
+    return &spreader_detector->components[spreader_detector->component_of[person->slot]];
+}
+
+/**
+ * Renumbers the slots of the people (and the indexes of the meetings) in the given order,
+ * so people who meet each other are close in the people array, the meetings array and
+ * every array indexed by slot - the propagation then walks memory mostly forward.
+ * The ids, the infection rates and the order of the report stay as they were (a rate is the
+ * highest over the meetings of the person, which does not depend on the order of the slots).
+ * The published rate snapshots are permuted, and the components relabeled if they were labeled.
+ * Must not be called together with any other function of the spreader detector
+ * (including the lock free readers).
+ * @param spreader_detector the spreader detector.
+ * @param strategy the order of the new slots.
+ * @return 1 if the people were renumbered successfully, 0 otherwise.
+ * @if_fails returns 0 (the spreader detector is left as it was).
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorReorder(SpreaderDetector *spreader_detector, SpreaderReorderStrategy strategy){
+    if (!spreader_detector || strategy > SPREADER_REORDER_DEGREE){
+        return 0;
+    }
+    size_t size = spreader_detector->people_size;
+    if (size == 0){
+        return 1;
+    }
+    size_t *neighbours = NULL;
+    size_t *offsets = BuildContactLists(spreader_detector, &neighbours);
+    size_t *by_degree = malloc(size*sizeof(size_t));
+    size_t *order = malloc(size*sizeof(size_t));
+    int success = offsets && by_degree && order &&
+                  SortByDegree(offsets, size, strategy != SPREADER_REORDER_DEGREE, by_degree);
+    if (success && strategy == SPREADER_REORDER_DEGREE){
+        memcpy(order, by_degree, size*sizeof(size_t));
+    }
+    else if (success && strategy == SPREADER_REORDER_BFS){
+        success = OrderBreadthFirst(offsets, neighbours, size, NULL, order);
+    }
+    else if (success){
+        // Cuthill-McKee starts each component from a person of minimal degree and visits
+        // the neighbours by increasing degree, then the order is reversed
+        success = SortContactListsByDegree(offsets, &neighbours, size, by_degree) &&
+                  OrderBreadthFirst(offsets, neighbours, size, by_degree, order);
+        for (size_t i = 0; success && i < size / 2; ++i) {
+            size_t temp = order[i];
+            order[i] = order[size - 1 - i];
+            order[size - 1 - i] = temp;
+        }
+    }
+    success = success && ApplyOrder(spreader_detector, order);
+    free(offsets);
+    free(neighbours);
+    free(by_degree);
+    free(order);
+    return success;
+}
+
+/**
+ * This function builds the contact lists of the people - the slots each person met
+ * (in both directions of the meetings), in the order of the meetings array
+ * @param spreader_detector the spreader detector
+ * @param p_neighbours output - the contact lists, one after the other
+ * @return the start of the contact list of each slot in the neighbours (size: people + 2),
+ * NULL if the lists could not be allocated
+ */
+size_t *BuildContactLists(const SpreaderDetector *spreader_detector, size_t **p_neighbours){
+    size_t size = spreader_detector->people_size;
+    size_t *offsets = calloc(size + 2, sizeof(size_t));
+    size_t *neighbours = malloc((2*spreader_detector->meeting_size + 1)*sizeof(size_t));
+    if (!offsets || !neighbours){
+        free(offsets);
+        free(neighbours);
+        return NULL;
+    }
+    // count into slot + 2, so after the prefix sum slot + 1 is the cursor of slot,
+    // and after the fill it is the end of slot
+    for (size_t i = 0; i < spreader_detector->meeting_size; ++i) {
+        offsets[spreader_detector->meetings[i]->person_1->slot + 2]++;
+        offsets[spreader_detector->meetings[i]->person_2->slot + 2]++;
+    }
+    for (size_t i = 2; i < size + 2; ++i) {
+        offsets[i] += offsets[i - 1];
+    }
+    for (size_t i = 0; i < spreader_detector->meeting_size; ++i) {
+        size_t slot_1 = spreader_detector->meetings[i]->person_1->slot;
+        size_t slot_2 = spreader_detector->meetings[i]->person_2->slot;
+        neighbours[offsets[slot_1 + 1]++] = slot_2;
+        neighbours[offsets[slot_2 + 1]++] = slot_1;
+    }
+    *p_neighbours = neighbours;
+    return offsets;
+}
+
+/**
+ * This function orders each contact list by the degree of the contacts (ascending)
+ * @param offsets the start of the contact list of each slot
+ * @param p_neighbours the contact lists (replaced by the ordered lists)
+ * @param size the number of people
+ * @param by_degree the slots, ordered by degree (ascending)
+ * @return true on success, false otherwise
+ */
+int SortContactListsByDegree(const size_t *offsets, size_t **p_neighbours, size_t size, const size_t *by_degree){
+    size_t *sorted = malloc((offsets[size] + 1)*sizeof(size_t));
+    size_t *cursors = malloc((size + 1)*sizeof(size_t));
+    if (!sorted || !cursors){
+        free(sorted);
+        free(cursors);
+        return false;
+    }
+    memcpy(cursors, offsets, size*sizeof(size_t));
+    // appending the contacts by increasing degree keeps every list in that order
+    for (size_t i = 0; i < size; ++i) {
+        size_t slot = by_degree[i];
+        for (size_t j = offsets[slot]; j < offsets[slot + 1]; ++j) {
+            sorted[cursors[(*p_neighbours)[j]]++] = slot;
+        }
+    }
+    free(cursors);
+    free(*p_neighbours);
+    *p_neighbours = sorted;
+    return true;
+}
+
+/**
+ * This function orders the slots by their degree with a (stable) counting sort
+ * @param offsets the start of the contact list of each slot
+ * @param size the number of people
+ * @param ascending true for the lowest degree first, false for the highest first
+ * @param by_degree output - the ordered slots
+ * @return true on success, false otherwise
+ */
+int SortByDegree(const size_t *offsets, size_t size, int ascending, size_t *by_degree){
+    size_t max_degree = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (offsets[i + 1] - offsets[i] > max_degree){
+            max_degree = offsets[i + 1] - offsets[i];
+        }
+    }
+    size_t *counts = calloc(max_degree + 2, sizeof(size_t));
+    if (!counts) return false;
+    for (size_t i = 0; i < size; ++i) {
+        size_t degree = offsets[i + 1] - offsets[i];
+        counts[(ascending ? degree : max_degree - degree) + 1]++;
+    }
+    for (size_t i = 1; i < max_degree + 2; ++i) {
+        counts[i] += counts[i - 1];
+    }
+    for (size_t i = 0; i < size; ++i) {
+        size_t degree = offsets[i + 1] - offsets[i];
+        by_degree[counts[ascending ? degree : max_degree - degree]++] = i;
+    }
+    free(counts);
+    return true;
+}
+
+/**
+ * This function orders the slots breadth first over the contact lists, starting
+ * a new search from each start which was not reached yet
+ * @param offsets the start of the contact list of each slot
+ * @param neighbours the contact lists
+ * @param size the number of people
+ * @param starts the slots to start from, in order (NULL - the slots in their order)
+ * @param order output - the slots in the order they were reached (also the queue of the search)
+ * @return true on success, false otherwise
+ */
+int OrderBreadthFirst(const size_t *offsets, const size_t *neighbours, size_t size,
+                      const size_t *starts, size_t *order){
+    char *reached = calloc(size, sizeof(char));
+    if (!reached) return false;
+    size_t tail = 0;
+    for (size_t i = 0; i < size; ++i) {
+        size_t start = starts ? starts[i] : i;
+        if (reached[start]) continue;
+        reached[start] = true;
+        order[tail++] = start;
+        for (size_t head = tail - 1; head < tail; ++head) {
+            size_t slot = order[head];
+            for (size_t j = offsets[slot]; j < offsets[slot + 1]; ++j) {
+                if (!reached[neighbours[j]]){
+                    reached[neighbours[j]] = true;
+                    order[tail++] = neighbours[j];
+                }
+            }
+        }
+    }
+    free(reached);
+    return true;
+}
+
+/**
+ * This function moves every person to its new slot, orders the meetings array by the
+ * new slot of person_1 (keeping the order of the meetings of each person), and updates
+ * everything indexed by slot or by meeting index
+ * @param spreader_detector the spreader detector
+ * @param order the old slot of each new slot
+ * @return true on success, false otherwise (nothing is changed then)
+ */
+int ApplyOrder(SpreaderDetector *spreader_detector, const size_t *order){
+    size_t size = spreader_detector->people_size;
+    Person **people = malloc(spreader_detector->people_cap*sizeof(void *));
+    Meeting **meetings = malloc((spreader_detector->meeting_cap + 1)*sizeof(void *));
+    size_t *new_slots = malloc(size*sizeof(size_t));
+    size_t *file_order = malloc(spreader_detector->people_cap*sizeof(size_t));
+    size_t *cursors = calloc(size + 1, sizeof(size_t));
+    size_t *id_index = calloc(spreader_detector->id_index_cap, sizeof(size_t));
+    double *rates[2] = {NULL, NULL};
+    int success = people && meetings && new_slots && file_order && cursors && id_index;
+    for (size_t i = 0; i < 2; ++i) {
+        if (success && spreader_detector->rate_snapshots[i].rates){
+            rates[i] = malloc(size*sizeof(double));
+            success = rates[i] != NULL;
+        }
+    }
+    if (!success){
+        free(people);
+        free(meetings);
+        free(new_slots);
+        free(file_order);
+        free(cursors);
+        free(id_index);
+        free(rates[0]);
+        free(rates[1]);
+        return false;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        new_slots[order[i]] = i;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        file_order[i] = new_slots[spreader_detector->file_order ? spreader_detector->file_order[i] : i];
+    }
+    // the people who joined after a snapshot have their initial rate in it (as the readers see it)
+    for (size_t k = 0; k < 2; ++k) {
+        RateSnapshot *snapshot = &spreader_detector->rate_snapshots[k];
+        for (size_t i = 0; rates[k] && i < size; ++i) {
+            rates[k][i] = order[i] < snapshot->size ? snapshot->rates[order[i]] :
+                          (spreader_detector->people[order[i]]->is_sick ? 1 : 0);
+        }
+        if (rates[k]){
+            free(snapshot->rates);
+            snapshot->rates = rates[k];
+            snapshot->size = size;
+            snapshot->capacity = size;
+        }
+    }
+    for (size_t i = 0; i < size; ++i) {
+        people[i] = spreader_detector->people[order[i]];
+        people[i]->slot = i;
+    }
+    // a stable counting sort of the meetings by the new slot of person_1
+    for (size_t i = 0; i < spreader_detector->meeting_size; ++i) {
+        cursors[spreader_detector->meetings[i]->person_1->slot + 1]++;
+    }
+    for (size_t i = 1; i < size; ++i) {
+        cursors[i] += cursors[i - 1];
+    }
+    for (size_t i = 0; i < spreader_detector->meeting_size; ++i) {
+        Meeting *meeting = spreader_detector->meetings[i];
+        meeting->index = cursors[meeting->person_1->slot]++;
+        meetings[meeting->index] = meeting;
+    }
+    FillIdIndex(people, size, id_index, spreader_detector->id_index_cap);
+
+    // an array in a region stays in place (the new order is copied into it)
+    if (spreader_detector->people_region.base){
+        memcpy(spreader_detector->people, people, size*sizeof(void *));
+        free(people);
+        people = spreader_detector->people;
+    }
+    if (spreader_detector->meetings_region.base){
+        memcpy(spreader_detector->meetings, meetings, spreader_detector->meeting_size*sizeof(void *));
+        free(meetings);
+        meetings = spreader_detector->meetings;
+    }
+    if (people != spreader_detector->people) free(spreader_detector->people);
+    if (meetings != spreader_detector->meetings) free(spreader_detector->meetings);
+    free(spreader_detector->file_order);
+    free(spreader_detector->id_index);
+    spreader_detector->people = people;
+    spreader_detector->meetings = meetings;
+    spreader_detector->file_order = file_order;
+    spreader_detector->file_order_cap = spreader_detector->people_cap;
+    spreader_detector->id_index = id_index;
+    free(new_slots);
+    free(cursors);
+
+    spreader_detector->lazy_epoch++;
+    // the columns are cheap to recompute (otherwise SpreaderDetectorCalculateInfectionChances does)
+    spreader_detector->person_additions_size = 0;
+    spreader_detector->meeting_weights_size = 0;
+    UpdatePolicyColumns(spreader_detector);
+    if (spreader_detector->labeled_size){
+        SpreaderDetectorLabelComponents(spreader_detector);
+    }
+    return true;
+}
+
+/**
+ * This function makes room for the propagation marks and stacks of all the people
+ * @param spreader_detector the spreader detector
+ * @return true on success, false otherwise
+ */
+int ReservePropagationScratch(SpreaderDetector *spreader_detector){
+    if (spreader_detector->propagation_marks_cap >= spreader_detector->people_size){
+        return true;
+    }
+    size_t capacity = spreader_detector->people_cap;
+    PropagationMark *marks = realloc(spreader_detector->propagation_marks, capacity*sizeof(PropagationMark));
+    if (!marks) return false;
+    // epoch 0 is never current
+    memset(marks + spreader_detector->propagation_marks_cap, 0,
+           (capacity - spreader_detector->propagation_marks_cap)*sizeof(PropagationMark));
+    spreader_detector->propagation_marks = marks;
+    size_t *stacks = realloc(spreader_detector->propagation_stacks, 3*capacity*sizeof(size_t));
+    if (!stacks) return false;
+    spreader_detector->propagation_stacks = stacks;
+    spreader_detector->propagation_marks_cap = capacity;
+    return true;
+}
+
+/**
+ * This function marks a person as part of the given propagation, with his/her initial rate
+ * @param spreader_detector the spreader detector
+ * @param slot the slot of the person
+ * @param epoch the propagation
+ */
+void StampPropagationMark(SpreaderDetector *spreader_detector, size_t slot, size_t epoch){
+    PropagationMark *mark = &spreader_detector->propagation_marks[slot];
+    mark->epoch = epoch;
+    mark->index = 0;
+    mark->low = 0;
+    mark->edge = 0;
+    mark->rate = spreader_detector->people[slot]->is_sick ? 1 : 0;
+    mark->flags = 0;
+}
+
+/**
+ * This function propagates the infection rates over the people the given people reach: finds the
+ * cycles of meetings on the way (Tarjan's strongly connected components, with explicit stacks -
+ * the chains of meetings may be long), and calculates the cycles sources first, so each person is
+ * calculated once, after everyone who met him/her
+ * @param spreader_detector the spreader detector (with the policy columns and the propagation scratch)
+ * @param starts the people to propagate from - the sick ones and the entered ones (the rest are skipped)
+ * @param num_of_starts the number of starts
+ * @param epoch the propagation
+ * @param restricted true - only the people already marked in this propagation are followed,
+ * false - the people are marked on the way
+ * @param offset the range of the propagation stacks to use (room for all the people reached)
+ * @param rates the infection rates (by slot) to write the reached people to (may be NULL)
+ */
+void PropagateReached(SpreaderDetector *spreader_detector, const size_t *starts, size_t num_of_starts,
+                      size_t epoch, int restricted, size_t offset, double *rates){
+    PropagationMark *marks = spreader_detector->propagation_marks;
+    size_t *calls = spreader_detector->propagation_stacks + offset;
+    size_t *stack = calls + spreader_detector->propagation_marks_cap;
+    size_t *order = stack + spreader_detector->propagation_marks_cap;
+    size_t num_of_calls = 0, stack_size = 0, order_size = 0, counter = 0, cycle = 0;
+    for (size_t i = 0; i < num_of_starts; ++i) {
+        size_t start = starts[i];
+        if (marks[start].epoch != epoch){
+            if (restricted) continue;
+            StampPropagationMark(spreader_detector, start, epoch);
+        }
+        if (marks[start].index != 0 ||
+            (!spreader_detector->people[start]->is_sick && !(marks[start].flags & PROPAGATION_MARK_ENTERED))){
+            continue;
+        }
+        marks[start].index = marks[start].low = ++counter;
+        marks[start].flags |= PROPAGATION_MARK_ON_STACK;
+        stack[stack_size++] = calls[num_of_calls++] = start;
+        while (num_of_calls > 0) {
+            size_t slot = calls[num_of_calls - 1];
+            PropagationMark *mark = &marks[slot];
+            const Person *person = spreader_detector->people[slot];
+            if (mark->edge < person->num_of_meetings){
+                size_t next = person->meetings[mark->edge++]->person_2->slot;
+                if (marks[next].epoch != epoch){
+                    if (restricted) continue;
+                    StampPropagationMark(spreader_detector, next, epoch);
+                }
+                if (marks[next].index == 0){
+                    marks[next].index = marks[next].low = ++counter;
+                    marks[next].flags |= PROPAGATION_MARK_ON_STACK;
+                    stack[stack_size++] = calls[num_of_calls++] = next;
+                }
+                else if ((marks[next].flags & PROPAGATION_MARK_ON_STACK) && marks[next].index < mark->low){
+                    mark->low = marks[next].index;
+                }
+                continue;
+            }
+            // every meeting of the person is followed
+            num_of_calls--;
+            if (num_of_calls > 0 && mark->low < marks[calls[num_of_calls - 1]].low){
+                marks[calls[num_of_calls - 1]].low = mark->low;
+            }
+            if (mark->low == mark->index){
+                // the person is the first of his/her cycle found (or a cycle by himself/herself)
+                size_t member;
+                do {
+                    member = stack[--stack_size];
+                    marks[member].flags = (marks[member].flags & ~PROPAGATION_MARK_ON_STACK) | PROPAGATION_MARK_DONE;
+                    marks[member].edge = cycle;
+                    marks[member].low = SIZE_MAX;
+                    order[order_size++] = member;
+                } while (member != slot);
+                cycle++;
+            }
+        }
+    }
+    // the cycles were found sinks first - calculate them sources first
+    size_t end = order_size;
+    while (end > 0) {
+        size_t begin = end - 1;
+        while (begin > 0 && marks[order[begin - 1]].edge == marks[order[end - 1]].edge) {
+            begin--;
+        }
+        PropagateCycle(spreader_detector, order + begin, end - begin, calls, rates);
+        end = begin;
+    }
+}
+
+/**
+ * This function calculates the people of a cycle (everyone who met them from outside is calculated):
+ * the people met from outside the cycle (or sick) keep their rate, and the rest are calculated breadth
+ * first from them, each from the people one meeting closer. Then the people they met outside the cycle
+ * are entered
+ * @param spreader_detector the spreader detector
+ * @param members the people of the cycle
+ * @param size the number of people in the cycle
+ * @param queue room for the people of the cycle
+ * @param rates the infection rates (by slot) to write the people of the cycle to (may be NULL)
+ */
+void PropagateCycle(SpreaderDetector *spreader_detector, const size_t *members, size_t size,
+                    size_t *queue, double *rates){
+    PropagationMark *marks = spreader_detector->propagation_marks;
+    const double *weights = spreader_detector->meeting_weights, *additions = spreader_detector->person_additions;
+    size_t epoch = marks[members[0]].epoch, cycle = marks[members[0]].edge;
+    if (size > 1){
+        size_t head = 0, tail = 0;
+        for (size_t i = 0; i < size; ++i) {
+            if (spreader_detector->people[members[i]]->is_sick || (marks[members[i]].flags & PROPAGATION_MARK_ENTERED)){
+                marks[members[i]].low = 0;
+                queue[tail++] = members[i];
+            }
+        }
+        while (head < tail) {
+            size_t slot = queue[head++];
+            const Person *person = spreader_detector->people[slot];
+            for (size_t i = 0; i < person->num_of_meetings; ++i) {
+                const Meeting *meeting = person->meetings[i];
+                PropagationMark *next = &marks[meeting->person_2->slot];
+                if (next->epoch != epoch || !(next->flags & PROPAGATION_MARK_DONE) || next->edge != cycle){
+                    continue;
+                }
+                if (next->low == SIZE_MAX){
+                    next->low = marks[slot].low + 1;
+                    queue[tail++] = meeting->person_2->slot;
+                }
+                if (next->low == marks[slot].low + 1){
+                    double rate = CalcCrna(meeting, weights, additions, marks[slot].rate);
+                    next->rate = rate > next->rate ? rate : next->rate;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < size; ++i) {
+        size_t slot = members[i];
+        const Person *person = spreader_detector->people[slot];
+        if (rates){
+            rates[slot] = marks[slot].rate;
+        }
+        for (size_t j = 0; j < person->num_of_meetings; ++j) {
+            const Meeting *meeting = person->meetings[j];
+            PropagationMark *next = &marks[meeting->person_2->slot];
+            if (next->epoch != epoch || !(next->flags & PROPAGATION_MARK_DONE) || next->edge == cycle){
+                continue;
+            }
+            double rate = CalcCrna(meeting, weights, additions, marks[slot].rate);
+            next->rate = rate > next->rate ? rate : next->rate;
+            next->flags |= PROPAGATION_MARK_ENTERED;
+        }
+    }
+}
+
+/**
+ * This function calculates the Crna of person2 according to the formula in the exercise.
+ * The policy is folded into the precomputed columns, so this is a multiply-add-clamp
+ * whatever the policy is.
+ * @param meeting the meeting
+ * @param weights the weight of each meeting (by meeting index)
+ * @param additions the age addition of each person (by slot)
+ * @param rate the infection rate of person_1
+ * @return the infection rate of person_2 through the meeting
+ */
+double CalcCrna(const Meeting *meeting, const double *weights, const double *additions, double rate){
+    rate = rate * weights[meeting->index] + additions[meeting->person_2->slot];
+    return rate > 1 ? 1 : rate;
+}
+
+/**
+ * Sets the scoring policy of the spreader detector, and precomputes the age addition
+ * of each person and the weight of each meeting under it (people and meetings added
+ * later are precomputed by SpreaderDetectorCalculateInfectionChances).
+ * @param spreader_detector the spreader detector.
+ * @param policy the policy (not owned - must outlive the spreader detector or be replaced),
+ * NULL for SpreaderPolicyDefault.
+ * @return 1 if the policy was set successfully, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorSetPolicy(SpreaderDetector *spreader_detector, const SpreaderPolicy *policy){
+    if (!spreader_detector){
+        return 0;
+    }
+    spreader_detector->policy = policy;
+    spreader_detector->lazy_epoch++;
+    spreader_detector->person_additions_size = 0;
+    spreader_detector->meeting_weights_size = 0;
+    return UpdatePolicyColumns(spreader_detector);
+}
+
+/**
+ * Returns the scoring policy of the spreader detector.
+ * @param spreader_detector the spreader detector.
+ * @return the policy (SpreaderPolicyDefault if none was set).
+ * @if_fails returns SpreaderPolicyDefault.
+ * @assumption you can not assume anything.
+ */
+const SpreaderPolicy *SpreaderDetectorGetPolicy(const SpreaderDetector *spreader_detector){
+    return spreader_detector && spreader_detector->policy ? spreader_detector->policy : SpreaderPolicyDefault();
+}
+
+/**
+ * This function precomputes the policy columns of the people and the meetings
+ * which were added since the last time
+ * @param spreader_detector the spreader detector
+ * @return true on success, false otherwise
+ */
+int UpdatePolicyColumns(SpreaderDetector *spreader_detector){
+    const SpreaderPolicy *policy = SpreaderDetectorGetPolicy(spreader_detector);
+    if (spreader_detector->person_additions_cap < spreader_detector->people_cap){
+        double *temp = realloc(spreader_detector->person_additions, spreader_detector->people_cap*sizeof(double));
+        if (!temp) return false;
+        spreader_detector->person_additions = temp;
+        spreader_detector->person_additions_cap = spreader_detector->people_cap;
+    }
+    if (spreader_detector->meeting_weights_cap < spreader_detector->meeting_cap){
+        double *temp = realloc(spreader_detector->meeting_weights, spreader_detector->meeting_cap*sizeof(double));
+        if (!temp) return false;
+        spreader_detector->meeting_weights = temp;
+        spreader_detector->meeting_weights_cap = spreader_detector->meeting_cap;
+    }
+    for (size_t i = spreader_detector->person_additions_size; i < spreader_detector->people_size; ++i) {
+        spreader_detector->person_additions[i] = SpreaderPolicyAgeAddition(policy, spreader_detector->people[i]->age);
+    }
+    spreader_detector->person_additions_size = spreader_detector->people_size;
+    for (size_t i = spreader_detector->meeting_weights_size; i < spreader_detector->meeting_size; ++i) {
+        Meeting *meeting = spreader_detector->meetings[i];
+        spreader_detector->meeting_weights[i] = SpreaderPolicyMeetingWeight(policy, meeting->measure, meeting->distance);
+    }
+    spreader_detector->meeting_weights_size = spreader_detector->meeting_size;
+    return true;
+}
+
+/**
+ * Gets the recommendation for treatment for all people based on the parameters above,
+ * and prints it to the given file path.
+ * @param spreader_detector the spreader detector contains the person.
+ * @param file_path the path to the output file.
+ * @return returns 1 if printed successfully, 0 otherwise.
+ * @if_fails return 0.
+ * @assumption you can assume that the path to the file is ok (and anything but that).
+ */
+int SpreaderDetectorPrintRecommendTreatmentToAll(SpreaderDetector *spreader_detector, const char *file_path){
+    SpreaderAllocPhase phase = SPREADER_ALLOC_SET_PHASE(SPREADER_ALLOC_PRINT);
+    FILE *file = fopen(file_path, "w"); // todo - free
+    if (!file){
+        (void) SPREADER_ALLOC_SET_PHASE(phase);
+        return 0;
+    }
+    // one generation for the whole report, even if a calculation is published meanwhile
+    const SpreaderPolicy *policy = SpreaderDetectorGetPolicy(spreader_detector);
+    const RateSnapshot *snapshot = SpreaderDetectorAcquireRates(spreader_detector);
+    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
+        size_t slot = spreader_detector->file_order ? spreader_detector->file_order[i] : i;
+        Person *person = spreader_detector->people[slot];
+        double rate = snapshot && slot < snapshot->size ? snapshot->rates[slot] : person->infection_rate;
+        fprintf(file, TREATMENT_MSG, SpreaderPolicyTreatment(policy, rate), person->name, person->id, person->age, rate);
+    }
+    SpreaderDetectorReleaseRates(spreader_detector, snapshot);
+    fclose(file);
+    (void) SPREADER_ALLOC_SET_PHASE(phase);
+    return 1;
+}
+
+
+size_t SpreaderDetectorGetNumOfPeople(SpreaderDetector *spreader_detector){
+    if (!spreader_detector){
+        return 0;
+    }
+    return spreader_detector->people_size;
+
+}
+
+
+size_t SpreaderDetectorGetNumOfMeetings(SpreaderDetector *spreader_detector){
+    if (!spreader_detector){
+        return 0;
+    }
+    return spreader_detector->meeting_size;
+}
+
+
+/**
+ * Returns the number of heap bytes the spreader detector, its people and its meetings use,
+ * broken down by what uses them (see SpreaderMemoryReport).
+ * Must not be called together with a function which changes the spreader detector.
+ * @param spreader_detector the spreader detector object.
+ * @param report output - the memory report.
+ * @return 1 if the report was filled, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorMemoryReport(SpreaderDetector *spreader_detector, SpreaderMemoryReport *report){
+    if (!spreader_detector || !report){
+        return 0;
+    }
+    memset(report, 0, sizeof(SpreaderMemoryReport));
+    report->detector = sizeof(SpreaderDetector);
+    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
+        const Person *person = spreader_detector->people[i];
+        report->people += sizeof(Person);
+        report->names += person->name ? strlen(person->name) + 1 : 0;
+        report->person_meetings += (person->num_of_meetings + person->num_of_incoming)*sizeof(void *);
+        report->person_meetings_slack += (person->meetings_capacity - person->num_of_meetings +
+                                          person->incoming_capacity - person->num_of_incoming)*sizeof(void *);
+    }
+    report->meetings = spreader_detector->meeting_size*sizeof(Meeting);
+    report->people_array = spreader_detector->people_size*sizeof(void *);
+    report->people_array_slack = (spreader_detector->people_cap - spreader_detector->people_size)*sizeof(void *);
+    report->meetings_array = spreader_detector->meeting_size*sizeof(void *);
+    report->meetings_array_slack = (spreader_detector->meeting_cap - spreader_detector->meeting_size)*sizeof(void *);
+
+    report->indices = (spreader_detector->id_index_cap + spreader_detector->file_order_cap)*sizeof(size_t);
+    if (spreader_detector->component_of){
+        report->indices += (spreader_detector->labeled_size + 1)*sizeof(size_t);
+    }
+    if (spreader_detector->components){
+        report->indices += (spreader_detector->num_of_components + 1)*sizeof(SpreaderComponent);
+    }
+    report->indices += spreader_detector->lazy_rates_cap*sizeof(LazyRate) +
+                       spreader_detector->lazy_stack_cap*sizeof(size_t);
+    report->indices += spreader_detector->neighborhood_marks_cap*sizeof(NeighborhoodMark) +
+                       2*spreader_detector->neighborhood_queue_cap*sizeof(NeighborhoodStep);
+    report->indices += spreader_detector->propagation_marks_cap*(sizeof(PropagationMark) + 3*sizeof(size_t));
+    for (size_t i = 0; i < SPREADER_DETECTOR_LOG_CHUNKS; ++i) {
+        if (atomic_load(&spreader_detector->meeting_log[i])){
+            report->indices += (SPREADER_DETECTOR_INITIAL_SIZE << i)*sizeof(MeetingLogEntry);
+        }
+    }
+
+    report->columns = (spreader_detector->person_additions_size + spreader_detector->meeting_weights_size)*sizeof(double);
+    report->columns_slack = (spreader_detector->person_additions_cap - spreader_detector->person_additions_size +
+                             spreader_detector->meeting_weights_cap - spreader_detector->meeting_weights_size)*sizeof(double);
+    for (size_t i = 0; i < 2; ++i) {
+        const RateSnapshot *snapshot = &spreader_detector->rate_snapshots[i];
+        report->columns += snapshot->size*sizeof(double);
+        report->columns_slack += (snapshot->capacity - snapshot->size)*sizeof(double);
+    }
+
+    report->total = report->detector + report->people + report->names + report->meetings +
+                    report->person_meetings + report->people_array + report->meetings_array +
+                    report->indices + report->columns + report->person_meetings_slack +
+                    report->people_array_slack + report->meetings_array_slack + report->columns_slack;
+    if (spreader_detector->people_region.base){
+        report->reserved += spreader_detector->people_region.reserved - spreader_detector->people_cap*sizeof(void *);
+    }
+    if (spreader_detector->meetings_region.base){
+        report->reserved += spreader_detector->meetings_region.reserved - spreader_detector->meeting_cap*sizeof(void *);
+    }
+    return 1;
+}
+
+/**
+ * Prints the memory report of the spreader detector to the given file, one field per line.
+ * @param spreader_detector the spreader detector object.
+ * @param file the file.
+ * @return 1 if printed successfully, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorPrintMemoryReport(SpreaderDetector *spreader_detector, FILE *file){
+    SpreaderMemoryReport report;
+    if (!file || !SpreaderDetectorMemoryReport(spreader_detector, &report)){
+        return 0;
+    }
+    fprintf(file, "detector: %zu\npeople: %zu\nnames: %zu\nmeetings: %zu\nperson_meetings: %zu\n"
+                  "people_array: %zu\nmeetings_array: %zu\nindices: %zu\ncolumns: %zu\n"
+                  "person_meetings_slack: %zu\npeople_array_slack: %zu\nmeetings_array_slack: %zu\n"
+                  "columns_slack: %zu\ntotal: %zu\nreserved: %zu\n",
+            report.detector, report.people, report.names, report.meetings, report.person_meetings,
+            report.people_array, report.meetings_array, report.indices, report.columns,
+            report.person_meetings_slack, report.people_array_slack, report.meetings_array_slack,
+            report.columns_slack, report.total, report.reserved);
+    return 1;
 }
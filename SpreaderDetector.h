@@ -4,6 +4,10 @@
 #include "Meeting.h"
 #include "Person.h"
 #include "Constants.h"
+#include "SpreaderPolicy.h"
+#include "SpreaderRegion.h"
+#include <pthread.h>
+#include <stdatomic.h>
 
 /**
  * @def SPREADER_DETECTOR_INITIAL_SIZE
@@ -18,6 +22,264 @@
  */
 #define SPREADER_DETECTOR_GROWTH_FACTOR 2UL
 
+/**
+ * @def SPREADER_DETECTOR_MAX_THREADS
+ * the maximal number of threads which propagate the infection rates
+ * (one connected component at a time).
+ */
+#define SPREADER_DETECTOR_MAX_THREADS 64UL
+
+/**
+ * @def SPREADER_DETECTOR_NUM_OF_STRIPES
+ * the number of locks which protect the meetings arrays of the people
+ * during concurrent insertion (person slot modulo the number of stripes).
+ */
+#define SPREADER_DETECTOR_NUM_OF_STRIPES 64UL
+
+/**
+ * @def SPREADER_DETECTOR_LOG_CHUNKS
+ * the number of chunks in the concurrent meetings log. Chunk k holds
+ * SPREADER_DETECTOR_INITIAL_SIZE * 2^k entries, so the log never moves an entry.
+ */
+#define SPREADER_DETECTOR_LOG_CHUNKS 48UL
+
+/**
+ * @struct MeetingLogEntry
+ * A meeting inserted concurrently, waiting for SpreaderDetectorCommitConcurrentMeetings.
+ * @param meeting the meeting.
+ * @param sequence the position of the meeting in the equivalent serial insertion order.
+ */
+typedef struct MeetingLogEntry {
+  Meeting *meeting;
+  size_t sequence;
+} MeetingLogEntry;
+
+/**
+ * @def SPREADER_DETECTOR_NO_SNAPSHOT
+ * the value of rate_front before the first calculation was published.
+ */
+#define SPREADER_DETECTOR_NO_SNAPSHOT 2UL
+
+/**
+ * @struct RateSnapshot
+ * A published generation of infection rates.
+ * @param rates the infection rate of each person (by slot).
+ * @param size the number of people in the snapshot.
+ * @param capacity the capacity of rates.
+ * @param generation the number of the calculation which produced the snapshot (starts at 1).
+ */
+typedef struct RateSnapshot {
+  double *rates;
+  size_t size;
+  size_t capacity;
+  size_t generation;
+} RateSnapshot;
+
+/**
+ * @struct SpreaderComponent
+ * A connected component of the meetings graph (ignoring the direction of the meetings).
+ * @param first_slot the smallest slot of a person in the component.
+ * @param size the number of people in the component.
+ * @param sick_count the number of sick people in the component.
+ * @param max_rate the maximal infection rate in the component,
+ * updated by SpreaderDetectorCalculateInfectionChances.
+ */
+typedef struct SpreaderComponent {
+  size_t first_slot;
+  size_t size;
+  size_t sick_count;
+  double max_rate;
+} SpreaderComponent;
+
+/**
+ * @def PROPAGATION_MARK_ON_STACK
+ * the person is on the stack of the strongly connected components search.
+ */
+#define PROPAGATION_MARK_ON_STACK 1
+
+/**
+ * @def PROPAGATION_MARK_DONE
+ * the cycle of the person is known (a sick person reaches him/her).
+ */
+#define PROPAGATION_MARK_DONE 2
+
+/**
+ * @def PROPAGATION_MARK_ENTERED
+ * a reached person from outside the cycle of the person met him/her.
+ */
+#define PROPAGATION_MARK_ENTERED 4
+
+/**
+ * @struct PropagationMark
+ * The state of a person during a propagation (see SpreaderDetectorCalculateInfectionChances).
+ * @param epoch the propagation the mark belongs to (the mark is valid only in it).
+ * @param index the order the person was found in (0 - not found yet).
+ * @param low the smallest index the person reaches on the stack - then (once done)
+ * the hops from the people the cycle of the person was entered at.
+ * @param edge the next meeting of the person to follow - then (once done) the cycle of the person.
+ * @param rate the infection rate of the person.
+ * @param flags PROPAGATION_MARK_ON_STACK, PROPAGATION_MARK_DONE and PROPAGATION_MARK_ENTERED.
+ */
+typedef struct PropagationMark {
+  size_t epoch;
+  size_t index;
+  size_t low;
+  size_t edge;
+  double rate;
+  int flags;
+} PropagationMark;
+
+/**
+ * @enum LazyRateState
+ * The state of a memoized lazy rate.
+ * @param LAZY_RATE_REACHED a sick person reaches the person - the people he/she
+ * met are infected through him/her.
+ * @param LAZY_RATE_UNREACHED no sick person reaches the person, and he/she is not sick.
+ */
+typedef enum LazyRateState {
+  LAZY_RATE_REACHED = 1,
+  LAZY_RATE_UNREACHED
+} LazyRateState;
+
+/**
+ * @struct LazyRate
+ * A memoized rate of SpreaderDetectorGetLazyInfectionRateById.
+ * @param rate the infection rate.
+ * @param epoch the lazy epoch the rate was calculated in (valid only in the current epoch).
+ * @param state the state of the rate (a LazyRateState).
+ */
+typedef struct LazyRate {
+  double rate;
+  size_t epoch;
+  int state;
+} LazyRate;
+
+/**
+ * @enum SpreaderDirection
+ * The meetings SpreaderDetectorNeighborhood follows from a person.
+ * @param SPREADER_DIRECTION_OUT the meetings the person is person_1 of (the people he/she may have infected).
+ * @param SPREADER_DIRECTION_IN the meetings the person is person_2 of (the people who may have infected him/her).
+ * @param SPREADER_DIRECTION_BOTH both.
+ */
+typedef enum SpreaderDirection {
+  SPREADER_DIRECTION_OUT = 1,
+  SPREADER_DIRECTION_IN = 2,
+  SPREADER_DIRECTION_BOTH = 3
+} SpreaderDirection;
+
+/**
+ * @struct SpreaderNeighbor
+ * A person of a neighborhood.
+ * @param person the person.
+ * @param hops the number of meetings on the shortest path from the center to the person.
+ * @param rate the best rate over the paths of at most k meetings from the center - the rate the
+ * person would get if the center was the only sick person and infected him/her along the path.
+ */
+typedef struct SpreaderNeighbor {
+  Person *person;
+  size_t hops;
+  double rate;
+} SpreaderNeighbor;
+
+/**
+ * @struct SpreaderNeighborhood
+ * The people within k meetings of a person, filled by SpreaderDetectorNeighborhood. Reused between
+ * queries (it only grows) - zero initialize it once, and free it with SpreaderNeighborhoodFree.
+ * @param neighbors the people, by increasing hops.
+ * @param size the number of people.
+ * @param capacity the capacity of neighbors.
+ */
+typedef struct SpreaderNeighborhood {
+  SpreaderNeighbor *neighbors;
+  size_t size;
+  size_t capacity;
+} SpreaderNeighborhood;
+
+/**
+ * @struct NeighborhoodMark
+ * The visited state of a person in SpreaderDetectorNeighborhood.
+ * @param epoch the query the mark belongs to (the mark is valid only in the current query).
+ * @param index the index of the person in the neighborhood (SIZE_MAX for the center).
+ * @param queued the hop the person was last queued at.
+ * @param position the position of the person in the queue of that hop.
+ */
+typedef struct NeighborhoodMark {
+  size_t epoch;
+  size_t index;
+  size_t queued;
+  size_t position;
+} NeighborhoodMark;
+
+/**
+ * @struct NeighborhoodStep
+ * A person whose meetings SpreaderDetectorNeighborhood follows in the next hop.
+ * @param slot the slot of the person.
+ * @param rate the rate of the person when queued.
+ */
+typedef struct NeighborhoodStep {
+  size_t slot;
+  double rate;
+} NeighborhoodStep;
+
+/**
+ * @enum SpreaderReorderStrategy
+ * The orders SpreaderDetectorReorder can renumber the people slots in.
+ * @param SPREADER_REORDER_BFS breadth first order over the meetings graph (ignoring the
+ * direction of the meetings), one component after the other.
+ * @param SPREADER_REORDER_RCM reverse Cuthill-McKee - breadth first order from a person of
+ * minimal degree, visiting the neighbours by increasing degree, reversed (keeps the slots of
+ * neighbours close to each other).
+ * @param SPREADER_REORDER_DEGREE by number of meetings (both directions), highest first
+ * (keeps the people who are visited the most together).
+ */
+typedef enum SpreaderReorderStrategy {
+  SPREADER_REORDER_BFS,
+  SPREADER_REORDER_RCM,
+  SPREADER_REORDER_DEGREE
+} SpreaderReorderStrategy;
+
+/**
+ * @struct SpreaderMemoryReport
+ * The heap bytes a spreader detector uses (requested sizes - without the headers
+ * and the rounding of the allocator).
+ * @param detector the spreader detector struct itself.
+ * @param people the Person structs.
+ * @param names the names of the people.
+ * @param meetings the Meeting structs.
+ * @param person_meetings the used entries of the meetings arrays of the people.
+ * @param people_array the used entries of the people array.
+ * @param meetings_array the used entries of the meetings array.
+ * @param indices the id index, the component labels and statistics, the file
+ * order of the people, the concurrent meetings log and the scratch of the
+ * propagation and of the queries.
+ * @param columns the used entries of the policy columns and the rate snapshots.
+ * @param person_meetings_slack the unused capacity of the meetings arrays of the
+ * people (PERSON_GROWTH_FACTOR).
+ * @param people_array_slack the unused capacity of the people array (SPREADER_DETECTOR_GROWTH_FACTOR).
+ * @param meetings_array_slack the unused capacity of the meetings array (SPREADER_DETECTOR_GROWTH_FACTOR).
+ * @param columns_slack the unused capacity of the policy columns and the rate snapshots.
+ * @param total the sum of all the above.
+ * @param reserved the address space the regions of the people and meetings arrays reserve
+ * beyond their capacity (see SpreaderDetectorSetPlacement) - not memory, and not in the total.
+ */
+typedef struct SpreaderMemoryReport {
+  size_t detector;
+  size_t people;
+  size_t names;
+  size_t meetings;
+  size_t person_meetings;
+  size_t people_array;
+  size_t meetings_array;
+  size_t indices;
+  size_t columns;
+  size_t person_meetings_slack;
+  size_t people_array_slack;
+  size_t meetings_array_slack;
+  size_t columns_slack;
+  size_t total;
+  size_t reserved;
+} SpreaderMemoryReport;
+
 /**
  * @struct SpreaderDetector
  * @param people a dynamic array of pointers to people.
@@ -30,6 +292,51 @@
  * meetings themselves.
  * @param meetings_size the size of the meetings array.
  * @param meetings_cap the capacity of the meetings array.
+ * @param people_region the region of the people array (empty - the array is on the heap).
+ * @param meetings_region the region of the meetings array (empty - the array is on the heap).
+ * @param component_of the component of each person (by slot),
+ * built by SpreaderDetectorLabelComponents.
+ * @param components the statistics of each component.
+ * @param num_of_components the number of components.
+ * @param labeled_size the number of people when the components were labeled.
+ * @param propagation_epoch the current propagation.
+ * @param propagation_marks the state of each person in the propagation (by slot).
+ * @param propagation_marks_cap the capacity of propagation_marks.
+ * @param propagation_stacks the stacks of the propagation - three arrays of propagation_marks_cap
+ * slots (each component uses the range of its people in all three).
+ * @param id_index an open-addressing hash index from id to (slot + 1), 0 marks an empty bucket.
+ * @param id_index_cap the capacity of the id index (a power of 2).
+ * @param person_locks the locks of the people meetings arrays during concurrent insertion.
+ * @param meeting_log the chunks of the concurrent meetings log (allocated on demand).
+ * @param meeting_log_size the number of entries reserved in the concurrent meetings log.
+ * @param rate_snapshots the front and back buffers of the infection rates.
+ * @param rate_readers the number of readers inside each buffer.
+ * @param rate_front the index of the published buffer (SPREADER_DETECTOR_NO_SNAPSHOT if none).
+ * @param rate_generation the generation of the last published buffer.
+ * @param policy the scoring policy (not owned, NULL - SpreaderPolicyDefault).
+ * @param person_additions the age addition of each person under the policy (by slot).
+ * @param person_additions_size the number of people person_additions covers.
+ * @param person_additions_cap the capacity of person_additions.
+ * @param meeting_weights the weight of each meeting under the policy (by meeting index).
+ * @param meeting_weights_size the number of meetings meeting_weights covers.
+ * @param meeting_weights_cap the capacity of meeting_weights.
+ * @param file_order the slot of each person in the order the people were added
+ * (NULL - the slots are in that order, until SpreaderDetectorReorder is called).
+ * @param file_order_cap the capacity of file_order.
+ * @param lazy_enabled 1 if the incoming meetings of the people are kept
+ * (built by the first SpreaderDetectorGetLazyInfectionRateById).
+ * @param lazy_epoch the current lazy epoch - advanced by every change of the people,
+ * the meetings or the policy, which drops all the memoized lazy rates.
+ * @param lazy_rates the memoized lazy rate of each person (by slot).
+ * @param lazy_rates_cap the capacity of lazy_rates.
+ * @param lazy_stack the people the queried lazy rate depends on.
+ * @param lazy_stack_cap the capacity of lazy_stack.
+ * @param neighborhood_epoch the current SpreaderDetectorNeighborhood query.
+ * @param neighborhood_marks the visited state of each person (by slot).
+ * @param neighborhood_marks_cap the capacity of neighborhood_marks.
+ * @param neighborhood_queue the people whose meetings are followed in the current hop.
+ * @param neighborhood_next the people whose meetings are followed in the next hop.
+ * @param neighborhood_queue_cap the capacity of neighborhood_queue and of neighborhood_next.
  */
 typedef struct SpreaderDetector {
   Person **people;
@@ -38,6 +345,46 @@ typedef struct SpreaderDetector {
   Meeting **meetings;
   size_t meeting_size;
   size_t meeting_cap;
+  SpreaderRegion people_region;
+  SpreaderRegion meetings_region;
+  size_t *component_of;
+  SpreaderComponent *components;
+  size_t num_of_components;
+  size_t labeled_size;
+  size_t propagation_epoch;
+  PropagationMark *propagation_marks;
+  size_t propagation_marks_cap;
+  size_t *propagation_stacks;
+  size_t *id_index;
+  size_t id_index_cap;
+  pthread_mutex_t person_locks[SPREADER_DETECTOR_NUM_OF_STRIPES];
+  _Atomic(MeetingLogEntry *) meeting_log[SPREADER_DETECTOR_LOG_CHUNKS];
+  atomic_size_t meeting_log_size;
+  RateSnapshot rate_snapshots[2];
+  atomic_size_t rate_readers[2];
+  atomic_size_t rate_front;
+  size_t rate_generation;
+  const SpreaderPolicy *policy;
+  double *person_additions;
+  size_t person_additions_size;
+  size_t person_additions_cap;
+  double *meeting_weights;
+  size_t meeting_weights_size;
+  size_t meeting_weights_cap;
+  size_t *file_order;
+  size_t file_order_cap;
+  int lazy_enabled;
+  size_t lazy_epoch;
+  LazyRate *lazy_rates;
+  size_t lazy_rates_cap;
+  size_t *lazy_stack;
+  size_t lazy_stack_cap;
+  size_t neighborhood_epoch;
+  NeighborhoodMark *neighborhood_marks;
+  size_t neighborhood_marks_cap;
+  NeighborhoodStep *neighborhood_queue;
+  NeighborhoodStep *neighborhood_next;
+  size_t neighborhood_queue_cap;
 } SpreaderDetector;
 
 /**
@@ -49,6 +396,25 @@ typedef struct SpreaderDetector {
  */
 SpreaderDetector *SpreaderDetectorAlloc();
 
+/**
+ * Places the people array and the meetings array in regions (see SpreaderRegion.h) in place of the heap:
+ * the address space of max_people / max_meetings pointers is reserved up front, and each array grows
+ * in place (committed a huge page at a time) - it is never copied, and never moves. The regions use
+ * transparent huge pages, and with SPREADER_NUMA_INTERLEAVE their pages are interleaved between
+ * the NUMA nodes (the parallel propagation reads them from all the nodes).
+ * The capacities are then hard limits - adding a person or a meeting beyond them fails.
+ * Must be called before the first person is added.
+ * @param spreader_detector the spreader detector.
+ * @param max_people the maximal number of people.
+ * @param max_meetings the maximal number of meetings.
+ * @param numa_policy the placement of the pages of the regions.
+ * @return 1 if the regions were reserved successfully, 0 otherwise.
+ * @if_fails returns 0 (the arrays stay on the heap).
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorSetPlacement(SpreaderDetector *spreader_detector, size_t max_people,
+                                 size_t max_meetings, SpreaderNumaPolicy numa_policy);
+
 /**
  * Frees the given spreader detector.
  * @param p_spreader_detector pointer to spreader detector pointer
@@ -79,26 +445,97 @@ int SpreaderDetectorAddPerson(SpreaderDetector *spreader_detector, Person *perso
  */
 int SpreaderDetectorAddMeeting(SpreaderDetector *spreader_detector, Meeting *meeting);
 
+/**
+ * Adds the given meeting to the spreader detector - may be called from several
+ * threads at the same time (but not together with any other function which changes
+ * the spreader detector). The meeting is added to the meetings array of person_1
+ * right away, and to the meetings of the spreader detector by
+ * SpreaderDetectorCommitConcurrentMeetings.
+ * Important - the people in the meeting should exist in the spreader detector.
+ * @param spreader_detector the spreader detector we wants to add the meeting to.
+ * @param meeting the meeting we wants to add to the spreader detector.
+ * @param sequence the position of the meeting in the serial insertion order
+ * (for example, its line in the meetings file) - the committed graph is the graph
+ * SpreaderDetectorAddMeeting would build if called in this order.
+ * @return 1 if the meeting was added successfully, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorAddMeetingConcurrent(SpreaderDetector *spreader_detector, Meeting *meeting, size_t sequence);
+
+/**
+ * Moves the meetings added by SpreaderDetectorAddMeetingConcurrent into the meetings of
+ * the spreader detector, and orders them (also in the meetings arrays of the people)
+ * by their sequence. Must be called after all the inserting threads finished, and
+ * before the infection chances are calculated.
+ * @param spreader_detector the spreader detector.
+ * @return 1 if the meetings were committed successfully, 0 otherwise.
+ * @if_fails returns 0 (the concurrent meetings stay uncommitted).
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorCommitConcurrentMeetings(SpreaderDetector *spreader_detector);
+
+/**
+ * Sets the scoring policy of the spreader detector, and precomputes the age addition
+ * of each person and the weight of each meeting under it (people and meetings added
+ * later are precomputed by SpreaderDetectorCalculateInfectionChances).
+ * @param spreader_detector the spreader detector.
+ * @param policy the policy (not owned - must outlive the spreader detector or be replaced),
+ * NULL for SpreaderPolicyDefault.
+ * @return 1 if the policy was set successfully, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorSetPolicy(SpreaderDetector *spreader_detector, const SpreaderPolicy *policy);
+
+/**
+ * Returns the scoring policy of the spreader detector.
+ * @param spreader_detector the spreader detector.
+ * @return the policy (SpreaderPolicyDefault if none was set).
+ * @if_fails returns SpreaderPolicyDefault.
+ * @assumption you can not assume anything.
+ */
+const SpreaderPolicy *SpreaderDetectorGetPolicy(const SpreaderDetector *spreader_detector);
+
 /**
  * This function reads the file of the meeting, parses to file into meetings,
- * and inserts it to the spreader detector.
+ * and inserts it to the spreader detector (see MeetingLine.h for the format of a line - reading
+ * stops at the first malformed line, or meeting which could not be inserted).
  * @param spreader_detector the spreader detector we wants to read the meetings into.
- * @param path the path to the meetings file.
+ * @param path the path to the meetings file (plain, gzip or zstd - see InputStream.h).
+ * @return 1 if the file was read (up to its end, or where reading stopped), 0 otherwise.
+ * @if_fails returns 0 (the file could not be opened, or read / decompressed - the meetings
+ * read before the error stay inserted).
  * @assumption you can assume that the path to the file is ok (and anything but that).
  */
-void SpreaderDetectorReadMeetingsFile(SpreaderDetector *spreader_detector, const char *path);
+int SpreaderDetectorReadMeetingsFile(SpreaderDetector *spreader_detector, const char *path);
 
 /**
  * This function reads the file of the people, parses to file into person objects,
- * and inserts it to the spreader detector.
+ * and inserts it to the spreader detector (reading stops at the first person who could not be inserted).
  * @param spreader_detector the spreader detector we wants to read the people into.
- * @param path the path to the people file.
+ * @param path the path to the people file (plain, gzip or zstd - see InputStream.h).
+ * @return 1 if the file was read (up to its end, or where reading stopped), 0 otherwise.
+ * @if_fails returns 0 (the file could not be opened, or read / decompressed, or out of memory -
+ * the people read before the error stay inserted).
  * @assumption you can assume that the path to the file is ok (and anything but that).
  */
-void SpreaderDetectorReadPeopleFile(SpreaderDetector *spreader_detector, const char *path);
+int SpreaderDetectorReadPeopleFile(SpreaderDetector *spreader_detector, const char *path);
+
+/**
+ * Returns the person with the given id (a constant time lookup in the id index).
+ * @param spreader_detector the spreader detector contains the person.
+ * @param id the id of the person we are looking for.
+ * @return the person, NULL if no such person exists.
+ * @if_fails returns NULL.
+ * @assumption you can not assume anything.
+ */
+Person *SpreaderDetectorGetPersonById(SpreaderDetector *spreader_detector, IdT id);
 
 /**
  * Returns the infection rate of the person with the given id.
+ * Reads the last published generation without taking a lock, so it may be called
+ * from other threads while SpreaderDetectorCalculateInfectionChances runs.
  * @param spreader_detector the spreader detector contains the person.
  * @param id the id of the person we are looking for.
  * @return the infection rate of the person, if not person exists -
@@ -108,18 +545,181 @@ void SpreaderDetectorReadPeopleFile(SpreaderDetector *spreader_detector, const c
  */
 double SpreaderDetectorGetInfectionRateById(SpreaderDetector *spreader_detector, IdT id);
 
+/**
+ * Returns the infection rate of the person with the given id, calculated on demand without
+ * SpreaderDetectorCalculateInfectionChances: walks back over the meetings the person was met in
+ * (and the meetings those people were met in, and so on) up to the sick people, and memoizes
+ * the rate of every person on the way until the people, the meetings or the policy change.
+ * The rate is the rate SpreaderDetectorCalculateInfectionChances calculates (whatever was
+ * queried before).
+ * The first call keeps the incoming meetings of all the people (one pass over the meetings),
+ * and later insertions keep them up to date.
+ * Must not be called together with any function which changes the spreader detector,
+ * nor with another call of this function.
+ * @param spreader_detector the spreader detector contains the person.
+ * @param id the id of the person we are looking for.
+ * @return the infection rate of the person, if not person exists -
+ * returns -1.
+ * @if_fails returns -1.
+ * @assumption you can not assume anything.
+ */
+double SpreaderDetectorGetLazyInfectionRateById(SpreaderDetector *spreader_detector, IdT id);
+
+/**
+ * Finds the people within k meetings of the person with the given id (not including him/her),
+ * with a breadth first search bounded by k, following the meetings in the given direction.
+ * A meeting followed against its direction uses the same weight (and the age addition of the
+ * person reached). The visited state is epoch stamped and kept in the spreader detector, so a
+ * query allocates nothing (once the scratch and the output are large enough) and clears nothing.
+ * Not thread safe - the queries share the scratch of the spreader detector.
+ * @param spreader_detector the spreader detector contains the person.
+ * @param id the id of the center of the neighborhood.
+ * @param k the maximal number of meetings from the center.
+ * @param direction the meetings to follow.
+ * @param neighborhood output - the people, by increasing hops (its previous content is dropped).
+ * @return 1 on success, 0 otherwise.
+ * @if_fails returns 0 (no such person, or out of memory - the neighborhood is then empty).
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorNeighborhood(SpreaderDetector *spreader_detector, IdT id, size_t k,
+                                 SpreaderDirection direction, SpreaderNeighborhood *neighborhood);
+
+/**
+ * Frees the people array of the given neighborhood (the neighborhood itself is not freed).
+ * @param neighborhood the neighborhood.
+ * @assumption you can not assume anything.
+ */
+void SpreaderNeighborhoodFree(SpreaderNeighborhood *neighborhood);
+
+/**
+ * Returns the infection rates of the people with the given ids, all from the same generation.
+ * @param spreader_detector the spreader detector contains the people.
+ * @param ids the ids of the people.
+ * @param num_of_ids the number of ids.
+ * @param rates output - the rate of each id (-1 if no such person).
+ * @return the generation of the rates (0 if no calculation was published yet -
+ * the rates are then the initial rates).
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+size_t SpreaderDetectorGetInfectionRatesByIds(SpreaderDetector *spreader_detector, const IdT *ids,
+                                              size_t num_of_ids, double *rates);
+
+/**
+ * Pins the last published generation of infection rates, so it is not overwritten
+ * by the next calculation until SpreaderDetectorReleaseRates is called.
+ * Lock free - may be called from other threads while SpreaderDetectorCalculateInfectionChances runs.
+ * @param spreader_detector the spreader detector.
+ * @return the snapshot (rates by slot), NULL if no calculation was published yet.
+ * @assumption you can not assume anything.
+ */
+const RateSnapshot *SpreaderDetectorAcquireRates(SpreaderDetector *spreader_detector);
+
+/**
+ * Releases a snapshot returned by SpreaderDetectorAcquireRates.
+ * @param spreader_detector the spreader detector.
+ * @param snapshot the snapshot (may be NULL).
+ */
+void SpreaderDetectorReleaseRates(SpreaderDetector *spreader_detector, const RateSnapshot *snapshot);
+
 /**
  * This function runs the algorithm which calculates the infection rates of the people.
  * When this algorithm ends, the user should be able to use the function
  * SpreaderDetectorGetInfectionRateById and get the infection rate of each person.
+ * A sick person has the rate 1. A person a sick person reaches gets the highest rate over the
+ * meetings he/she was met in by reached people (the rate of the other person times the weight of
+ * the meeting, plus the age addition, at most 1) - so the order of the people and of the meetings
+ * does not matter. The people of a cycle of meetings are calculated together, after everyone who
+ * met them from outside the cycle: the people met from outside (or sick) keep that rate, and the
+ * rest get the highest rate over the people of the cycle one meeting closer to them
+ * (a meeting back along the cycle is ignored).
+ * The rates are calculated into a back buffer, published with a single atomic swap,
+ * and then copied to the infection_rate of each person.
  * @param spreader_detector a spreader_detector.
  * @assumption you can not assume anything.
  */
 void SpreaderDetectorCalculateInfectionChances(SpreaderDetector *spreader_detector);
 
 /**
- * Gets the recommendation for treatment for all people based on the parameters above,
- * and prints it to the given file path.
+ * Publishes infection rates calculated outside of the spreader detector (e.g. by SpreaderExternalCalculate)
+ * as a new generation, the same way SpreaderDetectorCalculateInfectionChances publishes its rates.
+ * @param spreader_detector the spreader detector.
+ * @param rates the infection rate of each person, by slot (people_size entries).
+ * @return 1 if the rates were published successfully, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorPublishInfectionRates(SpreaderDetector *spreader_detector, const double *rates);
+
+/**
+ * Calculates the infection rates as SpreaderDetectorCalculateInfectionChances does, when some of
+ * the people are also met from outside the spreader detector (e.g. by the people of another shard):
+ * a person with an entry rate was met from outside with that rate (the highest of those meetings),
+ * and is calculated as a person met from outside his/her cycle. Nothing is published, and the
+ * people do not change.
+ * @param spreader_detector the spreader detector.
+ * @param entry_rates the entry rate of each person, by slot (negative - not met from outside).
+ * @param rates output - the infection rate of each person, by slot (people_size entries).
+ * @return 1 if the rates were calculated successfully, 0 otherwise.
+ * @if_fails returns 0 (out of memory).
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorCalculateEnteredRates(SpreaderDetector *spreader_detector, const double *entry_rates, double *rates);
+
+/**
+ * Labels the connected components of the meetings graph with union-find.
+ * Components are numbered by the order of their first person in the people array.
+ * Called by SpreaderDetectorCalculateInfectionChances, which propagates each
+ * component holding a sick person as an independent task and skips the rest.
+ * @param spreader_detector a spreader_detector.
+ * @return 1 if the components were labeled successfully, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorLabelComponents(SpreaderDetector *spreader_detector);
+
+/**
+ * Renumbers the slots of the people (and the indexes of the meetings) in the given order,
+ * so people who meet each other are close in the people array, the meetings array and
+ * every array indexed by slot - the propagation then walks memory mostly forward.
+ * The ids, the infection rates and the order of the report stay as they were (a rate is the
+ * highest over the meetings of the person, which does not depend on the order of the slots).
+ * The published rate snapshots are permuted, and the components relabeled if they were labeled.
+ * Must not be called together with any other function of the spreader detector
+ * (including the lock free readers).
+ * @param spreader_detector the spreader detector.
+ * @param strategy the order of the new slots.
+ * @return 1 if the people were renumbered successfully, 0 otherwise.
+ * @if_fails returns 0 (the spreader detector is left as it was).
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorReorder(SpreaderDetector *spreader_detector, SpreaderReorderStrategy strategy);
+
+/**
+ * Returns the statistics of the connected components (size, sick count, max rate),
+ * as labeled by the last call to SpreaderDetectorLabelComponents.
+ * @param spreader_detector the spreader detector object.
+ * @param num_of_components output - the number of components.
+ * @return the components array (owned by the spreader detector).
+ * @if_fails returns NULL and sets *num_of_components to 0.
+ * @assumption you can not assume anything.
+ */
+const SpreaderComponent *SpreaderDetectorGetComponents(SpreaderDetector *spreader_detector,
+                                                       size_t *num_of_components);
+
+/**
+ * Returns the statistics of the component of the person with the given id.
+ * @param spreader_detector the spreader detector contains the person.
+ * @param id the id of the person we are looking for.
+ * @return the component of the person.
+ * @if_fails returns NULL (no such person, or the components are not labeled).
+ * @assumption you can not assume anything.
+ */
+const SpreaderComponent *SpreaderDetectorGetComponentById(SpreaderDetector *spreader_detector, IdT id);
+
+/**
+ * Gets the recommendation for treatment for all people based on the treatment tiers
+ * of the policy, and prints it to the given file path.
  * @param spreader_detector the spreader detector contains the person.
  * @param file_path the path to the output file.
  * @return returns 1 if printed successfully, 0 otherwise.
@@ -150,4 +750,26 @@ size_t SpreaderDetectorGetNumOfPeople(SpreaderDetector *spreader_detector);
  */
 size_t SpreaderDetectorGetNumOfMeetings(SpreaderDetector *spreader_detector);
 
+/**
+ * Returns the number of heap bytes the spreader detector, its people and its meetings use,
+ * broken down by what uses them (see SpreaderMemoryReport).
+ * Must not be called together with a function which changes the spreader detector.
+ * @param spreader_detector the spreader detector object.
+ * @param report output - the memory report.
+ * @return 1 if the report was filled, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorMemoryReport(SpreaderDetector *spreader_detector, SpreaderMemoryReport *report);
+
+/**
+ * Prints the memory report of the spreader detector to the given file, one field per line.
+ * @param spreader_detector the spreader detector object.
+ * @param file the file.
+ * @return 1 if printed successfully, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderDetectorPrintMemoryReport(SpreaderDetector *spreader_detector, FILE *file);
+
 #endif //SPREADERDETECTOR_H
@@ -0,0 +1,66 @@
+/**
+ * The external memory detector - builds a CSR file of the meetings and calculates the report
+ * over it, without holding the meetings in memory (see SpreaderExternal.h).
+ * Build:
+ * gcc -O2 -pthread SpreaderDetectorExternal.c SpreaderExternal.c SpreaderDetector.c
+ *     SpreaderPolicy.c SpreaderRegion.c Person.c Meeting.c MeetingLine.c InputStream.c -o SpreaderDetectorExternal
+ * Usage:
+ * SpreaderDetectorExternal <people_file> <meetings_file> <csr_file> <output_file> [policy_file]
+ * (an existing csr_file is rebuilt)
+ */
+
+#include "SpreaderExternal.h"
+
+#define USAGE_MSG "Usage: SpreaderDetectorExternal <people_file> <meetings_file> <csr_file> " \
+                  "<output_file> [policy_file]\n"
+#define NUM_OF_ARGS 5
+#define NUM_OF_ARGS_WITH_POLICY 6
+
+/**
+ * Frees the people of the spreader detector, and the spreader detector itself.
+ * @param p_spreader_detector pointer to the spreader detector.
+ */
+void FreeAll(SpreaderDetector **p_spreader_detector){
+    SpreaderDetector *spreader_detector = *p_spreader_detector;
+    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
+        PersonFree(&spreader_detector->people[i]);
+    }
+    SpreaderDetectorFree(p_spreader_detector);
+}
+
+int main(int argc, char *argv[]){
+    if (argc != NUM_OF_ARGS && argc != NUM_OF_ARGS_WITH_POLICY){
+        fprintf(stderr, USAGE_MSG);
+        return EXIT_FAILURE;
+    }
+    SpreaderPolicy *policy = NULL;
+    if (argc == NUM_OF_ARGS_WITH_POLICY){
+        policy = SpreaderPolicyLoad(argv[5]);
+        if (!policy){
+            fprintf(stderr, "Failed to load the policy %s\n", argv[5]);
+            return EXIT_FAILURE;
+        }
+    }
+    SpreaderDetector *spreader_detector = SpreaderDetectorAlloc();
+    if (!spreader_detector){
+        SpreaderPolicyFree(&policy);
+        return EXIT_FAILURE;
+    }
+    SpreaderExternalGraph *graph = NULL;
+    int success = SpreaderDetectorReadPeopleFile(spreader_detector, argv[1]) &&
+                  SpreaderDetectorSetPolicy(spreader_detector, policy) &&
+                  SpreaderExternalBuild(spreader_detector, argv[2], argv[3], 0) &&
+                  (graph = SpreaderExternalOpen(argv[3])) != NULL &&
+                  SpreaderExternalCalculate(spreader_detector, graph, 0) &&
+                  SpreaderDetectorPrintRecommendTreatmentToAll(spreader_detector, argv[4]);
+    if (!success){
+        fprintf(stderr, "The external memory run failed\n");
+    }
+    else {
+        fprintf(stderr, "%zu people, %zu meetings\n", graph->num_of_people, graph->num_of_edges);
+    }
+    SpreaderExternalClose(&graph);
+    FreeAll(&spreader_detector);
+    SpreaderPolicyFree(&policy);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
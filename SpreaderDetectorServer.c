@@ -0,0 +1,98 @@
+/**
+ * The query daemon - loads a spreader detector once and serves it over a unix socket
+ * (see SpreaderServer.h for the protocol).
+ * Build:
+ * gcc -O2 -pthread SpreaderDetectorServer.c SpreaderServer.c SpreaderDetector.c
+ *     SpreaderPolicy.c SpreaderRegion.c Person.c Meeting.c MeetingLine.c InputStream.c -o SpreaderDetectorServer
+ * (with -DSPREADER_DETECTOR_TRACK_ALLOCATIONS and SpreaderAlloc.c the allocations of
+ * each phase are printed to stderr on exit - see SpreaderAlloc.h)
+ * Usage:
+ * SpreaderDetectorServer <people_file> <meetings_file> <socket_path> [policy_file]
+ */
+
+#define _GNU_SOURCE // sigaction, pthread_rwlock_t
+#include "SpreaderServer.h"
+#include <signal.h>
+#include "SpreaderAlloc.h"
+
+#define USAGE_MSG "Usage: SpreaderDetectorServer <people_file> <meetings_file> <socket_path> [policy_file]\n"
+#define NUM_OF_ARGS 4
+#define NUM_OF_ARGS_WITH_POLICY 5
+
+static SpreaderServer *g_server = NULL;
+
+/**
+ * Stops the server on SIGINT / SIGTERM.
+ * @param signal_number the signal.
+ */
+void StopServer(int signal_number){
+    (void) signal_number;
+    SpreaderServerStop(g_server);
+}
+
+/**
+ * Frees the people and the meetings of the spreader detector, and the spreader detector itself.
+ * @param p_spreader_detector pointer to the spreader detector.
+ */
+void FreeAll(SpreaderDetector **p_spreader_detector){
+    SpreaderDetector *spreader_detector = *p_spreader_detector;
+    for (size_t i = 0; i < spreader_detector->meeting_size; ++i) {
+        MeetingFree(&spreader_detector->meetings[i]);
+    }
+    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
+        PersonFree(&spreader_detector->people[i]);
+    }
+    SpreaderDetectorFree(p_spreader_detector);
+}
+
+int main(int argc, char *argv[]){
+    if (argc != NUM_OF_ARGS && argc != NUM_OF_ARGS_WITH_POLICY){
+        fprintf(stderr, USAGE_MSG);
+        return EXIT_FAILURE;
+    }
+    SpreaderPolicy *policy = NULL;
+    if (argc == NUM_OF_ARGS_WITH_POLICY){
+        policy = SpreaderPolicyLoad(argv[4]);
+        if (!policy){
+            fprintf(stderr, "Failed to load the policy %s\n", argv[4]);
+            return EXIT_FAILURE;
+        }
+    }
+    SpreaderDetector *spreader_detector = SpreaderDetectorAlloc();
+    if (!spreader_detector){
+        SpreaderPolicyFree(&policy);
+        return EXIT_FAILURE;
+    }
+    if (!SpreaderDetectorReadPeopleFile(spreader_detector, argv[1]) ||
+        !SpreaderDetectorReadMeetingsFile(spreader_detector, argv[2])){
+        fprintf(stderr, "Failed to read %s or %s\n", argv[1], argv[2]);
+        FreeAll(&spreader_detector);
+        SpreaderPolicyFree(&policy);
+        return EXIT_FAILURE;
+    }
+    // renumber the people once, before anything reads the detector (the rates do not change)
+    SpreaderDetectorReorder(spreader_detector, SPREADER_REORDER_BFS);
+    SpreaderDetectorSetPolicy(spreader_detector, policy);
+    SpreaderDetectorCalculateInfectionChances(spreader_detector);
+
+    g_server = SpreaderServerAlloc(spreader_detector, argv[3]);
+    if (!g_server){
+        fprintf(stderr, "Failed to listen on %s\n", argv[3]);
+        FreeAll(&spreader_detector);
+        SpreaderPolicyFree(&policy);
+        return EXIT_FAILURE;
+    }
+    struct sigaction action = {.sa_handler = StopServer};
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    int success = SpreaderServerRun(g_server);
+    SpreaderServerFree(&g_server);
+    FreeAll(&spreader_detector);
+    SpreaderPolicyFree(&policy);
+#ifdef SPREADER_DETECTOR_TRACK_ALLOCATIONS
+    SpreaderAllocPrintStats(stderr);
+#endif
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
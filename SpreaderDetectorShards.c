@@ -0,0 +1,59 @@
+/**
+ * The sharded detector - calculates the report with several worker processes
+ * (see SpreaderShards.h).
+ * Build:
+ * gcc -O2 -pthread SpreaderDetectorShards.c SpreaderShards.c SpreaderDetector.c
+ *     SpreaderPolicy.c SpreaderRegion.c Person.c Meeting.c MeetingLine.c InputStream.c -o SpreaderDetectorShards
+ * Usage:
+ * SpreaderDetectorShards <people_file> <meetings_file> <num_of_shards> <output_file> [policy_file] [--check]
+ * (--check compares the report with the one of the in-memory detector - see SpreaderShardsCheck)
+ */
+
+#include "SpreaderShards.h"
+
+#define USAGE_MSG "Usage: SpreaderDetectorShards <people_file> <meetings_file> <num_of_shards> " \
+                  "<output_file> [policy_file] [--check]\n"
+#define CHECK_ARG "--check"
+#define NUM_OF_ARGS 5
+#define NUM_OF_ARGS_WITH_POLICY 6
+
+int main(int argc, char *argv[]){
+    int check = argc > NUM_OF_ARGS && strcmp(argv[argc - 1], CHECK_ARG) == 0;
+    if (check){
+        --argc;
+    }
+    if (argc != NUM_OF_ARGS && argc != NUM_OF_ARGS_WITH_POLICY){
+        fprintf(stderr, USAGE_MSG);
+        return EXIT_FAILURE;
+    }
+    char *end;
+    size_t num_of_shards = strtoul(argv[3], &end, 10);
+    if (*end || num_of_shards == 0 || num_of_shards > SPREADER_SHARDS_MAX_SHARDS){
+        fprintf(stderr, USAGE_MSG);
+        return EXIT_FAILURE;
+    }
+    SpreaderPolicy *policy = NULL;
+    if (argc == NUM_OF_ARGS_WITH_POLICY){
+        policy = SpreaderPolicyLoad(argv[5]);
+        if (!policy){
+            fprintf(stderr, "Failed to load the policy %s\n", argv[5]);
+            return EXIT_FAILURE;
+        }
+    }
+    SpreaderShardsStats stats;
+    int success = SpreaderShardsRun(argv[1], argv[2], num_of_shards, policy, argv[4], &stats);
+    if (!success){
+        fprintf(stderr, "The sharded run failed\n");
+        SpreaderPolicyFree(&policy);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "%zu rounds, %zu boundary messages, %zu cross-shard meetings, %zu people on cycles\n",
+            stats.rounds, stats.messages, stats.cross_meetings, stats.cycle_people);
+    if (check){
+        success = SpreaderShardsCheck(argv[1], argv[2], policy, argv[4]);
+        fprintf(stderr, success ? "The report matches the in-memory detector\n" :
+                                  "The report differs from the in-memory detector\n");
+    }
+    SpreaderPolicyFree(&policy);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
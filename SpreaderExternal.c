@@ -0,0 +1,907 @@
+#define _GNU_SOURCE // pread
+#include "SpreaderExternal.h"
+#include "InputStream.h"
+#include "MeetingLine.h"
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "SpreaderAlloc.h"
+
+/**
+ * @def MAX_RUN_PATH
+ * the maximal length of the path of a run file.
+ */
+#define MAX_RUN_PATH 4096
+
+/**
+ * @def EXTERNAL_CYCLE_WINDOW
+ * the number of edges the cycle pass reads at a time - its depth first search jumps between
+ * people, so a small window reads less per jump.
+ */
+#define EXTERNAL_CYCLE_WINDOW 1024UL
+
+/**
+ * @def EXTERNAL_REACHED
+ * the mark of a person a sick person reaches.
+ */
+#define EXTERNAL_REACHED 1
+
+/**
+ * @def EXTERNAL_CALCULATED
+ * the mark of a reached person whose rate is final.
+ */
+#define EXTERNAL_CALCULATED 2
+
+/**
+ * @def EXTERNAL_ENTERED
+ * the mark of a person met by a calculated person (from outside his/her cycle).
+ */
+#define EXTERNAL_ENTERED 4
+
+/**
+ * @def EXTERNAL_ON_STACK
+ * the mark of a person on the stack of the cycle search.
+ */
+#define EXTERNAL_ON_STACK 8
+
+/**
+ * @struct ExternalRun
+ * A sorted run of meetings in an (unlinked) temporary file.
+ * @param file the file of the run.
+ * @param level the number of merges the meetings of the run went through.
+ */
+typedef struct ExternalRun {
+  FILE *file;
+  size_t level;
+} ExternalRun;
+
+/**
+ * @struct ExternalBuilder
+ * The state of SpreaderExternalBuild.
+ * @param csr_path the path of the CSR file (the runs are created next to it).
+ * @param buffer the meetings which were not spilled yet.
+ * @param buffer_size the number of meetings in the buffer.
+ * @param buffer_capacity the number of meetings the buffer holds.
+ * @param runs the runs, the newest last (their levels do not increase).
+ * @param num_of_runs the number of runs.
+ * @param runs_capacity the capacity of the runs array.
+ * @param num_of_files the number of run files created so far (names them).
+ */
+typedef struct ExternalBuilder {
+  const char *csr_path;
+  ExternalEdge *buffer;
+  size_t buffer_size;
+  size_t buffer_capacity;
+  ExternalRun *runs;
+  size_t num_of_runs;
+  size_t runs_capacity;
+  size_t num_of_files;
+} ExternalBuilder;
+
+/**
+ * @struct RunHead
+ * The next meeting of a run being merged.
+ * @param edge the meeting.
+ * @param file the file of the run.
+ */
+typedef struct RunHead {
+  ExternalEdge edge;
+  FILE *file;
+} RunHead;
+
+/**
+ * @struct EdgeWindow
+ * The edges of the CSR file read last - the frontiers are sorted by slot, so a window
+ * usually serves the edges of many people before the next read.
+ * @param graph the CSR file.
+ * @param buffer the edges.
+ * @param capacity the number of edges the buffer holds.
+ * @param first the index of the first edge in the buffer.
+ * @param size the number of edges in the buffer.
+ */
+typedef struct EdgeWindow {
+  const SpreaderExternalGraph *graph;
+  CsrEdge *buffer;
+  size_t capacity;
+  size_t first;
+  size_t size;
+} EdgeWindow;
+
+/**
+ * @struct ExternalPass
+ * The state of SpreaderExternalCalculate.
+ * @param spreader_detector the spreader detector.
+ * @param policy the policy of the spreader detector.
+ * @param rates the infection rates (by slot).
+ * @param remaining the number of reached people who met each person and were not calculated yet
+ * (the cycle pass - the low link of the person, then his/her distance in his/her cycle).
+ * @param marks the marks of each person (EXTERNAL_REACHED, EXTERNAL_CALCULATED, ...).
+ * @param frontier the people whose edges are read in the current step (sorted by slot).
+ * @param next the people whose edges are read in the next step.
+ * @param window the edges read last.
+ */
+typedef struct ExternalPass {
+  SpreaderDetector *spreader_detector;
+  const SpreaderPolicy *policy;
+  double *rates;
+  size_t *remaining;
+  unsigned char *marks;
+  size_t *frontier;
+  size_t *next;
+  EdgeWindow window;
+} ExternalPass;
+
+int ParseExternalMeetings(SpreaderDetector *spreader_detector, InputStream *file,
+                          ExternalBuilder *builder, uint64_t *counts);
+int SpillRun(ExternalBuilder *builder);
+FILE *OpenRunFile(ExternalBuilder *builder);
+int MergeRuns(ExternalRun *runs, size_t num_of_runs, FILE *output, bool csr, size_t *num_of_edges);
+void SiftDown(RunHead *heap, size_t size, size_t index);
+int CompareExternalEdges(const void *a, const void *b);
+int EdgeBefore(const ExternalEdge *a, const ExternalEdge *b);
+int WriteCsrFile(ExternalBuilder *builder, const uint64_t *counts, size_t num_of_people, size_t num_of_edges);
+void CloseRuns(ExternalBuilder *builder);
+int ReadFully(int fd, void *buffer, size_t size, size_t offset);
+const CsrEdge *ReadEdges(EdgeWindow *window, size_t begin, size_t end, size_t *count);
+int ReachPass(ExternalPass *pass);
+int RatePass(ExternalPass *pass);
+int CyclePass(ExternalPass *pass);
+int FindCycles(ExternalPass *pass, EdgeWindow *window, size_t *index, size_t *cursors,
+               size_t *order, size_t *order_size);
+int CalculateCycle(ExternalPass *pass, EdgeWindow *window, const size_t *cycles,
+                   const size_t *members, size_t size);
+int PendingPerson(const ExternalPass *pass, size_t slot);
+double EdgeRate(const ExternalPass *pass, size_t slot, const CsrEdge *edge);
+int CompareSlots(const void *a, const void *b);
+
+
+/**
+ * Parses the meetings file into a CSR file over the slots of the people of the spreader detector,
+ * holding at most run_bytes of meetings in memory. The runs are unlinked temporary files next to
+ * the CSR file. Like SpreaderDetectorReadMeetingsFile, stops at the first malformed line or meeting with
+ * an unknown person.
+ * The people of the spreader detector must not change (nor be reordered) until the CSR file is used.
+ * @param spreader_detector the spreader detector, with the people.
+ * @param meetings_path the path to the meetings file (plain, gzip or zstd - see InputStream.h).
+ * @param csr_path the path of the CSR file.
+ * @param run_bytes the size of the run buffer (0 - SPREADER_EXTERNAL_DEFAULT_BUFFER).
+ * @return 1 if the CSR file was built successfully, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderExternalBuild(SpreaderDetector *spreader_detector, const char *meetings_path,
+                          const char *csr_path, size_t run_bytes){
+    if (!spreader_detector || !meetings_path || !csr_path){
+        return 0;
+    }
+    SpreaderAllocPhase phase = SPREADER_ALLOC_SET_PHASE(SPREADER_ALLOC_READ_MEETINGS);
+    size_t num_of_people = spreader_detector->people_size;
+    ExternalBuilder builder = {.csr_path = csr_path};
+    builder.buffer_capacity = (run_bytes ? run_bytes : SPREADER_EXTERNAL_DEFAULT_BUFFER)/sizeof(ExternalEdge);
+    if (builder.buffer_capacity == 0){
+        builder.buffer_capacity = 1;
+    }
+    builder.buffer = malloc(builder.buffer_capacity*sizeof(ExternalEdge));
+    // the number of meetings of each slot, shifted by one (the offsets are their prefix sums)
+    uint64_t *counts = calloc(num_of_people + 1, sizeof(uint64_t));
+    InputStream *file = InputStreamOpen(meetings_path);
+    int success = builder.buffer && counts && file;
+    if (success){
+        success = ParseExternalMeetings(spreader_detector, file, &builder, counts) && SpillRun(&builder);
+    }
+    if (success){
+        size_t num_of_edges = 0;
+        for (size_t i = 1; i <= num_of_people; ++i) {
+            num_of_edges += counts[i];
+            counts[i] = num_of_edges;
+        }
+        success = WriteCsrFile(&builder, counts, num_of_people, num_of_edges);
+    }
+    InputStreamClose(&file);
+    CloseRuns(&builder);
+    free(builder.runs);
+    free(builder.buffer);
+    free(counts);
+    (void) SPREADER_ALLOC_SET_PHASE(phase);
+    return success;
+}
+
+/**
+ * This function parses the lines of the meetings file into the buffer of the builder, and spills
+ * the buffer whenever it is full (stops at the first malformed line, or meeting with an unknown person)
+ * @param spreader_detector the spreader detector (with the people)
+ * @param file the meetings file
+ * @param builder the builder
+ * @param counts the number of meetings of each slot (at slot + 1) to update
+ * @return 1 on success, 0 if a run could not be spilled
+ */
+int ParseExternalMeetings(SpreaderDetector *spreader_detector, InputStream *file,
+                          ExternalBuilder *builder, uint64_t *counts){
+    char buffer[MAX_LEN_OF_LINE];
+    uint64_t sequence = 0;
+    while (InputStreamGetLine(file, buffer, MAX_LEN_OF_LINE)) {
+        MeetingLine line;
+        if (!MeetingLineParse(buffer, MAX_LEN_OF_LINE, &line)){
+            break;
+        }
+        Person *p1 = SpreaderDetectorGetPersonById(spreader_detector, line.id_1);
+        Person *p2 = SpreaderDetectorGetPersonById(spreader_detector, line.id_2);
+        if (!p1 || !p2){
+            break;
+        }
+        if (builder->buffer_size == builder->buffer_capacity && !SpillRun(builder)){
+            return 0;
+        }
+        builder->buffer[builder->buffer_size++] = (ExternalEdge) {p1->slot, p2->slot, line.measure, line.distance, sequence++};
+        ++counts[p1->slot + 1];
+    }
+    return !InputStreamHasError(file);
+}
+
+/**
+ * This function sorts the buffer of the builder into a new run, and merges the newest runs
+ * whenever SPREADER_EXTERNAL_FAN_IN of them have the same level
+ * (so each meeting is merged O(log_FAN_IN(runs)) times, with few files open)
+ * @param builder the builder
+ * @return 1 on success, 0 otherwise
+ */
+int SpillRun(ExternalBuilder *builder){
+    if (builder->buffer_size == 0){
+        return 1;
+    }
+    qsort(builder->buffer, builder->buffer_size, sizeof(ExternalEdge), CompareExternalEdges);
+    if (builder->num_of_runs == builder->runs_capacity){
+        size_t capacity = builder->runs_capacity ? 2*builder->runs_capacity : SPREADER_EXTERNAL_FAN_IN;
+        ExternalRun *runs = realloc(builder->runs, capacity*sizeof(ExternalRun));
+        if (!runs) return 0;
+        builder->runs = runs;
+        builder->runs_capacity = capacity;
+    }
+    FILE *file = OpenRunFile(builder);
+    if (!file){
+        return 0;
+    }
+    builder->runs[builder->num_of_runs++] = (ExternalRun) {file, 0};
+    if (fwrite(builder->buffer, sizeof(ExternalEdge), builder->buffer_size, file) != builder->buffer_size){
+        return 0;
+    }
+    builder->buffer_size = 0;
+    while (builder->num_of_runs >= SPREADER_EXTERNAL_FAN_IN) {
+        ExternalRun *newest = &builder->runs[builder->num_of_runs - SPREADER_EXTERNAL_FAN_IN];
+        if (newest->level != builder->runs[builder->num_of_runs - 1].level){
+            break;
+        }
+        FILE *merged = OpenRunFile(builder);
+        size_t num_of_edges;
+        if (!merged || !MergeRuns(newest, SPREADER_EXTERNAL_FAN_IN, merged, false, &num_of_edges)){
+            if (merged) fclose(merged);
+            return 0;
+        }
+        size_t level = newest->level + 1;
+        for (size_t i = 0; i < SPREADER_EXTERNAL_FAN_IN; ++i) {
+            fclose(newest[i].file);
+        }
+        builder->num_of_runs -= SPREADER_EXTERNAL_FAN_IN;
+        builder->runs[builder->num_of_runs++] = (ExternalRun) {merged, level};
+    }
+    return 1;
+}
+
+/**
+ * This function creates a run file next to the CSR file and unlinks it right away,
+ * so it is removed when closed (even if the process dies)
+ * @param builder the builder
+ * @return the run file, NULL if it could not be created
+ */
+FILE *OpenRunFile(ExternalBuilder *builder){
+    char path[MAX_RUN_PATH];
+    int length = snprintf(path, sizeof(path), "%s.run%zu", builder->csr_path, builder->num_of_files++);
+    if (length < 0 || (size_t) length >= sizeof(path)){
+        return NULL;
+    }
+    FILE *file = fopen(path, "w+b");
+    if (!file){
+        return NULL;
+    }
+    remove(path);
+    setvbuf(file, NULL, _IOFBF, SPREADER_EXTERNAL_IO_BUFFER);
+    return file;
+}
+
+/**
+ * This function merges the given sorted runs into the output file (the runs stay open)
+ * @param runs the runs
+ * @param num_of_runs the number of runs
+ * @param output the output file
+ * @param csr true to write the meetings as CsrEdges, false to write them as a run
+ * @param num_of_edges output - the number of meetings written
+ * @return 1 on success, 0 otherwise
+ */
+int MergeRuns(ExternalRun *runs, size_t num_of_runs, FILE *output, bool csr, size_t *num_of_edges){
+    *num_of_edges = 0;
+    RunHead *heap = malloc((num_of_runs ? num_of_runs : 1)*sizeof(RunHead));
+    if (!heap){
+        return 0;
+    }
+    size_t size = 0;
+    int success = 1;
+    for (size_t i = 0; i < num_of_runs && success; ++i) {
+        if (fflush(runs[i].file) != 0 || fseek(runs[i].file, 0, SEEK_SET) != 0){
+            success = 0;
+        }
+        else if (fread(&heap[size].edge, sizeof(ExternalEdge), 1, runs[i].file) == 1){
+            heap[size++].file = runs[i].file;
+        }
+    }
+    for (size_t i = size; i-- > 0 && success;) {
+        SiftDown(heap, size, i);
+    }
+    while (size > 0 && success) {
+        const ExternalEdge *edge = &heap[0].edge;
+        if (csr){
+            CsrEdge csr_edge = {edge->to, edge->measure, edge->distance};
+            success = fwrite(&csr_edge, sizeof(CsrEdge), 1, output) == 1;
+        }
+        else {
+            success = fwrite(edge, sizeof(ExternalEdge), 1, output) == 1;
+        }
+        ++*num_of_edges;
+        if (fread(&heap[0].edge, sizeof(ExternalEdge), 1, heap[0].file) != 1){
+            success = success && !ferror(heap[0].file);
+            heap[0] = heap[--size];
+        }
+        SiftDown(heap, size, 0);
+    }
+    free(heap);
+    return success && fflush(output) == 0;
+}
+
+/**
+ * This function restores the heap property of the merge heap below the given index
+ * @param heap the heap (the smallest meeting first)
+ * @param size the number of heads in the heap
+ * @param index the index
+ */
+void SiftDown(RunHead *heap, size_t size, size_t index){
+    while (true) {
+        size_t smallest = index;
+        size_t left = 2*index + 1, right = 2*index + 2;
+        if (left < size && EdgeBefore(&heap[left].edge, &heap[smallest].edge)){
+            smallest = left;
+        }
+        if (right < size && EdgeBefore(&heap[right].edge, &heap[smallest].edge)){
+            smallest = right;
+        }
+        if (smallest == index){
+            return;
+        }
+        RunHead head = heap[index];
+        heap[index] = heap[smallest];
+        heap[smallest] = head;
+        index = smallest;
+    }
+}
+
+/**
+ * This function compares two meetings for qsort by the slot of person_1, and then by their line
+ * @param a the first meeting
+ * @param b the second meeting
+ * @return negative, 0 or positive
+ */
+int CompareExternalEdges(const void *a, const void *b){
+    const ExternalEdge *edge_a = (const ExternalEdge *) a;
+    const ExternalEdge *edge_b = (const ExternalEdge *) b;
+    if (EdgeBefore(edge_a, edge_b)){
+        return -1;
+    }
+    return EdgeBefore(edge_b, edge_a) ? 1 : 0;
+}
+
+/**
+ * This function checks if a meeting comes before another in a run
+ * @param a the first meeting
+ * @param b the second meeting
+ * @return 1 if a comes before b, 0 otherwise
+ */
+int EdgeBefore(const ExternalEdge *a, const ExternalEdge *b){
+    return a->from < b->from || (a->from == b->from && a->sequence < b->sequence);
+}
+
+/**
+ * This function writes the CSR file - the header, the offsets and the merge of the runs
+ * @param builder the builder (all the meetings are in its runs)
+ * @param offsets the offsets of the slots (num_of_people + 1 entries)
+ * @param num_of_people the number of people
+ * @param num_of_edges the number of meetings
+ * @return 1 on success, 0 otherwise
+ */
+int WriteCsrFile(ExternalBuilder *builder, const uint64_t *offsets, size_t num_of_people, size_t num_of_edges){
+    FILE *file = fopen(builder->csr_path, "wb");
+    if (!file){
+        return 0;
+    }
+    setvbuf(file, NULL, _IOFBF, SPREADER_EXTERNAL_IO_BUFFER);
+    CsrHeader header = {.num_of_people = num_of_people, .num_of_edges = num_of_edges};
+    memcpy(header.magic, SPREADER_EXTERNAL_MAGIC, sizeof(header.magic));
+    size_t written = 0;
+    int success = fwrite(&header, sizeof(CsrHeader), 1, file) == 1 &&
+                  fwrite(offsets, sizeof(uint64_t), num_of_people + 1, file) == num_of_people + 1 &&
+                  MergeRuns(builder->runs, builder->num_of_runs, file, true, &written) &&
+                  written == num_of_edges;
+    if (fclose(file) != 0){
+        success = 0;
+    }
+    if (!success){
+        remove(builder->csr_path);
+    }
+    return success;
+}
+
+/**
+ * This function closes (and so removes) the runs of the builder
+ * @param builder the builder
+ */
+void CloseRuns(ExternalBuilder *builder){
+    for (size_t i = 0; i < builder->num_of_runs; ++i) {
+        fclose(builder->runs[i].file);
+    }
+    builder->num_of_runs = 0;
+}
+
+/**
+ * Opens a CSR file built by SpreaderExternalBuild (reads its header and offsets).
+ * @param csr_path the path of the CSR file.
+ * @return pointer to dynamically allocated SpreaderExternalGraph.
+ * @if_fails returns NULL.
+ * @assumption you can not assume anything.
+ */
+SpreaderExternalGraph *SpreaderExternalOpen(const char *csr_path){
+    if (!csr_path){
+        return NULL;
+    }
+    int fd = open(csr_path, O_RDONLY);
+    if (fd < 0){
+        return NULL;
+    }
+    CsrHeader header;
+    SpreaderExternalGraph *graph = NULL;
+    if (ReadFully(fd, &header, sizeof(CsrHeader), 0) &&
+        memcmp(header.magic, SPREADER_EXTERNAL_MAGIC, sizeof(header.magic)) == 0 &&
+        header.num_of_people < SIZE_MAX/sizeof(uint64_t) - 1){
+        graph = malloc(sizeof(SpreaderExternalGraph));
+    }
+    if (!graph){
+        close(fd);
+        return NULL;
+    }
+    graph->fd = fd;
+    graph->num_of_people = header.num_of_people;
+    graph->num_of_edges = header.num_of_edges;
+    graph->edges_offset = sizeof(CsrHeader) + (graph->num_of_people + 1)*sizeof(uint64_t);
+    graph->offsets = malloc((graph->num_of_people + 1)*sizeof(uint64_t));
+    int valid = graph->offsets &&
+                ReadFully(fd, graph->offsets, (graph->num_of_people + 1)*sizeof(uint64_t), sizeof(CsrHeader)) &&
+                graph->offsets[0] == 0 && graph->offsets[graph->num_of_people] == graph->num_of_edges;
+    for (size_t i = 0; valid && i < graph->num_of_people; ++i) {
+        valid = graph->offsets[i] <= graph->offsets[i + 1];
+    }
+    if (!valid){
+        SpreaderExternalClose(&graph);
+    }
+    return graph;
+}
+
+/**
+ * Closes the given CSR file.
+ * @param p_graph pointer to dynamically allocated graph.
+ * @assumption you can not assume anything.
+ */
+void SpreaderExternalClose(SpreaderExternalGraph **p_graph){
+    if (!p_graph || !*p_graph){
+        return;
+    }
+    close((*p_graph)->fd);
+    free((*p_graph)->offsets);
+    free(*p_graph);
+    *p_graph = NULL;
+}
+
+/**
+ * This function reads exactly size bytes at the given offset of the file
+ * @param fd the file descriptor
+ * @param buffer the buffer
+ * @param size the number of bytes
+ * @param offset the offset in the file
+ * @return 1 on success, 0 otherwise (including the end of the file)
+ */
+int ReadFully(int fd, void *buffer, size_t size, size_t offset){
+    char *bytes = buffer;
+    while (size > 0) {
+        ssize_t result = pread(fd, bytes, size, (off_t) offset);
+        if (result < 0 && errno == EINTR){
+            continue;
+        }
+        if (result <= 0){
+            return 0;
+        }
+        bytes += result;
+        size -= (size_t) result;
+        offset += (size_t) result;
+    }
+    return 1;
+}
+
+/**
+ * This function returns the edges from begin (up to end) which are in the window, reading
+ * a new window from begin if it is not in the current one
+ * @param window the window
+ * @param begin the index of the first edge
+ * @param end the index after the last edge (at most the number of edges)
+ * @param count output - the number of edges returned (at least 1)
+ * @return the edges, NULL if they could not be read
+ */
+const CsrEdge *ReadEdges(EdgeWindow *window, size_t begin, size_t end, size_t *count){
+    if (begin < window->first || begin >= window->first + window->size){
+        size_t wanted = window->graph->num_of_edges - begin;
+        wanted = wanted < window->capacity ? wanted : window->capacity;
+        if (!ReadFully(window->graph->fd, window->buffer, wanted*sizeof(CsrEdge),
+                       window->graph->edges_offset + begin*sizeof(CsrEdge))){
+            window->size = 0;
+            return NULL;
+        }
+        window->first = begin;
+        window->size = wanted;
+    }
+    size_t available = window->first + window->size - begin;
+    *count = end - begin < available ? end - begin : available;
+    return window->buffer + (begin - window->first);
+}
+
+/**
+ * Calculates the infection rates of the people of the spreader detector over the meetings of the
+ * CSR file, and publishes them (see SpreaderDetectorPublishInfectionRates).
+ * @param spreader_detector the spreader detector the CSR file was built with.
+ * @param graph the CSR file.
+ * @param read_bytes the size of the read window (0 - SPREADER_EXTERNAL_DEFAULT_BUFFER).
+ * @return 1 if the rates were calculated successfully, 0 otherwise.
+ * @if_fails returns 0 (the file could not be read - nothing is published then).
+ * @assumption you can not assume anything.
+ */
+int SpreaderExternalCalculate(SpreaderDetector *spreader_detector, SpreaderExternalGraph *graph, size_t read_bytes){
+    if (!spreader_detector || !graph || graph->num_of_people != spreader_detector->people_size){
+        return 0;
+    }
+    if (graph->num_of_people == 0){
+        return 1;
+    }
+    SpreaderAllocPhase phase = SPREADER_ALLOC_SET_PHASE(SPREADER_ALLOC_CALCULATE);
+    size_t size = graph->num_of_people;
+    ExternalPass pass = {.spreader_detector = spreader_detector,
+                         .policy = SpreaderDetectorGetPolicy(spreader_detector)};
+    pass.rates = malloc(size*sizeof(double));
+    pass.remaining = calloc(size, sizeof(size_t));
+    pass.marks = calloc(size, sizeof(unsigned char));
+    pass.frontier = malloc(size*sizeof(size_t));
+    pass.next = malloc(size*sizeof(size_t));
+    pass.window.graph = graph;
+    pass.window.capacity = (read_bytes ? read_bytes : SPREADER_EXTERNAL_DEFAULT_BUFFER)/sizeof(CsrEdge);
+    if (pass.window.capacity == 0){
+        pass.window.capacity = 1;
+    }
+    pass.window.buffer = malloc(pass.window.capacity*sizeof(CsrEdge));
+    int success = pass.rates && pass.remaining && pass.marks && pass.frontier && pass.next && pass.window.buffer;
+    success = success && ReachPass(&pass) && RatePass(&pass) && CyclePass(&pass) &&
+              SpreaderDetectorPublishInfectionRates(spreader_detector, pass.rates);
+    free(pass.rates);
+    free(pass.remaining);
+    free(pass.marks);
+    free(pass.frontier);
+    free(pass.next);
+    free(pass.window.buffer);
+    (void) SPREADER_ALLOC_SET_PHASE(phase);
+    return success;
+}
+
+/**
+ * This function finds the people the sick people reach, breadth first, and counts
+ * the reached people who met each person
+ * @param pass the state of the calculation
+ * @return 1 on success, 0 if the edges could not be read (or the file is corrupt)
+ */
+int ReachPass(ExternalPass *pass){
+    const SpreaderExternalGraph *graph = pass->window.graph;
+    size_t size = 0;
+    for (size_t i = 0; i < graph->num_of_people; ++i) {
+        if (pass->spreader_detector->people[i]->is_sick){
+            pass->marks[i] = EXTERNAL_REACHED;
+            pass->frontier[size++] = i;
+        }
+    }
+    while (size > 0) {
+        size_t next_size = 0;
+        for (size_t i = 0; i < size; ++i) {
+            size_t slot = pass->frontier[i], end = graph->offsets[slot + 1];
+            size_t count;
+            for (size_t begin = graph->offsets[slot]; begin < end; begin += count) {
+                const CsrEdge *edges = ReadEdges(&pass->window, begin, end, &count);
+                if (!edges) return 0;
+                for (size_t j = 0; j < count; ++j) {
+                    size_t to = edges[j].to;
+                    if (to >= graph->num_of_people) return 0;
+                    ++pass->remaining[to];
+                    if (!pass->marks[to]){
+                        pass->marks[to] = EXTERNAL_REACHED;
+                        pass->next[next_size++] = to;
+                    }
+                }
+            }
+        }
+        qsort(pass->next, next_size, sizeof(size_t), CompareSlots);
+        size_t *frontier = pass->frontier;
+        pass->frontier = pass->next;
+        pass->next = frontier;
+        size = next_size;
+    }
+    return 1;
+}
+
+/**
+ * This function calculates the rates, starting from the sick people no reached person met -
+ * a person is calculated (and his/her edges are read) once all the reached people who met
+ * him/her are, and gets the highest of their rates (a sick person keeps 1). The people on (or
+ * after) a cycle are left for CyclePass
+ * @param pass the state of the calculation (after ReachPass)
+ * @return 1 on success, 0 if the edges could not be read
+ */
+int RatePass(ExternalPass *pass){
+    const SpreaderExternalGraph *graph = pass->window.graph;
+    Person **people = pass->spreader_detector->people;
+    size_t size = 0;
+    for (size_t i = 0; i < graph->num_of_people; ++i) {
+        pass->rates[i] = people[i]->is_sick ? 1 : 0;
+        if (people[i]->is_sick && pass->remaining[i] == 0){
+            pass->marks[i] |= EXTERNAL_CALCULATED;
+            pass->frontier[size++] = i;
+        }
+    }
+    while (size > 0) {
+        size_t next_size = 0;
+        for (size_t i = 0; i < size; ++i) {
+            size_t slot = pass->frontier[i], end = graph->offsets[slot + 1];
+            size_t count;
+            for (size_t begin = graph->offsets[slot]; begin < end; begin += count) {
+                const CsrEdge *edges = ReadEdges(&pass->window, begin, end, &count);
+                if (!edges) return 0;
+                for (size_t j = 0; j < count; ++j) {
+                    size_t to = edges[j].to;
+                    double rate = EdgeRate(pass, slot, &edges[j]);
+                    pass->rates[to] = pass->rates[to] > rate ? pass->rates[to] : rate;
+                    pass->marks[to] |= EXTERNAL_ENTERED;
+                    if (--pass->remaining[to] == 0){
+                        pass->marks[to] |= EXTERNAL_CALCULATED;
+                        pass->next[next_size++] = to;
+                    }
+                }
+            }
+        }
+        qsort(pass->next, next_size, sizeof(size_t), CompareSlots);
+        size_t *frontier = pass->frontier;
+        pass->frontier = pass->next;
+        pass->next = frontier;
+        size = next_size;
+    }
+    return 1;
+}
+
+/**
+ * This function calculates the reached people RatePass left waiting - they are on a cycle of
+ * meetings, or after one. Their cycles are found (Tarjan's strongly connected components, with
+ * explicit stacks) and calculated sources first, with the cycle rule of
+ * SpreaderDetectorCalculateInfectionChances
+ * @param pass the state of the calculation (after RatePass)
+ * @return 1 on success, 0 if the edges could not be read (or out of memory)
+ */
+int CyclePass(ExternalPass *pass){
+    size_t size = pass->window.graph->num_of_people, waiting = 0;
+    for (size_t i = 0; i < size; ++i) {
+        waiting += PendingPerson(pass, i);
+    }
+    if (waiting == 0){
+        return 1;
+    }
+    EdgeWindow window = {.graph = pass->window.graph};
+    window.capacity = pass->window.capacity < EXTERNAL_CYCLE_WINDOW ? pass->window.capacity : EXTERNAL_CYCLE_WINDOW;
+    window.buffer = malloc(window.capacity*sizeof(CsrEdge));
+    // the index of each person in the search (then the cycle of the person), the next edge
+    // of each person, and the people by cycle - sinks first
+    size_t *index = calloc(size, sizeof(size_t));
+    size_t *cursors = malloc(size*sizeof(size_t));
+    size_t *order = malloc(size*sizeof(size_t));
+    size_t order_size = 0;
+    int success = window.buffer && index && cursors && order &&
+                  FindCycles(pass, &window, index, cursors, order, &order_size);
+    // calculate the cycles sources first
+    for (size_t end = order_size; success && end > 0;) {
+        size_t begin = end - 1;
+        while (begin > 0 && index[order[begin - 1]] == index[order[end - 1]]) {
+            begin--;
+        }
+        success = CalculateCycle(pass, &window, index, order + begin, end - begin);
+        end = begin;
+    }
+    free(window.buffer);
+    free(index);
+    free(cursors);
+    free(order);
+    return success;
+}
+
+/**
+ * This function finds the cycles of meetings between the waiting people (Tarjan's strongly
+ * connected components - the low links are kept in remaining, the calls and the stack in
+ * frontier and next)
+ * @param pass the state of the calculation
+ * @param window the window to read the edges with
+ * @param index output - the cycle of each waiting person (a number from 1, the same for the
+ * people of a cycle)
+ * @param cursors room for the next edge of each person
+ * @param order output - the waiting people, cycle by cycle (sinks first)
+ * @param order_size output - the number of people in order
+ * @return 1 on success, 0 if the edges could not be read
+ */
+int FindCycles(ExternalPass *pass, EdgeWindow *window, size_t *index, size_t *cursors,
+               size_t *order, size_t *order_size){
+    const SpreaderExternalGraph *graph = window->graph;
+    size_t *low = pass->remaining, *calls = pass->frontier, *stack = pass->next;
+    size_t num_of_calls = 0, stack_size = 0, counter = 0, cycle = 0;
+    for (size_t start = 0; start < graph->num_of_people; ++start) {
+        if (!PendingPerson(pass, start) || index[start] != 0){
+            continue;
+        }
+        index[start] = low[start] = ++counter;
+        cursors[start] = graph->offsets[start];
+        pass->marks[start] |= EXTERNAL_ON_STACK;
+        stack[stack_size++] = calls[num_of_calls++] = start;
+        while (num_of_calls > 0) {
+            size_t slot = calls[num_of_calls - 1], end = graph->offsets[slot + 1];
+            if (cursors[slot] < end){
+                size_t count;
+                const CsrEdge *edges = ReadEdges(window, cursors[slot], end, &count);
+                if (!edges) return 0;
+                for (size_t j = 0; j < count; ++j) {
+                    size_t next = edges[j].to;
+                    cursors[slot]++;
+                    if (!PendingPerson(pass, next)) continue;
+                    if (index[next] == 0){
+                        index[next] = low[next] = ++counter;
+                        cursors[next] = graph->offsets[next];
+                        pass->marks[next] |= EXTERNAL_ON_STACK;
+                        stack[stack_size++] = calls[num_of_calls++] = next;
+                        break;
+                    }
+                    if ((pass->marks[next] & EXTERNAL_ON_STACK) && index[next] < low[slot]){
+                        low[slot] = index[next];
+                    }
+                }
+                continue;
+            }
+            // every meeting of the person is followed
+            num_of_calls--;
+            if (num_of_calls > 0 && low[slot] < low[calls[num_of_calls - 1]]){
+                low[calls[num_of_calls - 1]] = low[slot];
+            }
+            if (low[slot] == index[slot]){
+                // the person is the first of his/her cycle found (or a cycle by himself/herself)
+                cycle++;
+                size_t member;
+                do {
+                    member = stack[--stack_size];
+                    pass->marks[member] &= (unsigned char) ~EXTERNAL_ON_STACK;
+                    index[member] = cycle;
+                    low[member] = SIZE_MAX;
+                    order[(*order_size)++] = member;
+                } while (member != slot);
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * This function calculates the people of a cycle (everyone who met them from outside is calculated):
+ * the people met from outside the cycle (or sick) keep their rate, and the rest are calculated breadth
+ * first from them, each from the people one meeting closer (their distances are kept in remaining).
+ * Then the people they met outside the cycle are entered
+ * @param pass the state of the calculation
+ * @param window the window to read the edges with
+ * @param cycles the cycle of each waiting person
+ * @param members the people of the cycle
+ * @param size the number of people in the cycle
+ * @return 1 on success, 0 if the edges could not be read
+ */
+int CalculateCycle(ExternalPass *pass, EdgeWindow *window, const size_t *cycles,
+                   const size_t *members, size_t size){
+    const SpreaderExternalGraph *graph = window->graph;
+    size_t *distances = pass->remaining, *queue = pass->frontier, cycle = cycles[members[0]];
+    if (size > 1){
+        size_t head = 0, tail = 0;
+        for (size_t i = 0; i < size; ++i) {
+            if (pass->spreader_detector->people[members[i]]->is_sick || (pass->marks[members[i]] & EXTERNAL_ENTERED)){
+                distances[members[i]] = 0;
+                queue[tail++] = members[i];
+            }
+        }
+        while (head < tail) {
+            size_t slot = queue[head++], end = graph->offsets[slot + 1], count;
+            for (size_t begin = graph->offsets[slot]; begin < end; begin += count) {
+                const CsrEdge *edges = ReadEdges(window, begin, end, &count);
+                if (!edges) return 0;
+                for (size_t j = 0; j < count; ++j) {
+                    size_t next = edges[j].to;
+                    if (!PendingPerson(pass, next) || cycles[next] != cycle) continue;
+                    if (distances[next] == SIZE_MAX){
+                        distances[next] = distances[slot] + 1;
+                        queue[tail++] = next;
+                    }
+                    if (distances[next] == distances[slot] + 1){
+                        double rate = EdgeRate(pass, slot, &edges[j]);
+                        pass->rates[next] = rate > pass->rates[next] ? rate : pass->rates[next];
+                    }
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < size; ++i) {
+        pass->marks[members[i]] |= EXTERNAL_CALCULATED;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        size_t slot = members[i], end = graph->offsets[slot + 1], count;
+        for (size_t begin = graph->offsets[slot]; begin < end; begin += count) {
+            const CsrEdge *edges = ReadEdges(window, begin, end, &count);
+            if (!edges) return 0;
+            for (size_t j = 0; j < count; ++j) {
+                size_t next = edges[j].to;
+                if (!PendingPerson(pass, next)) continue;
+                double rate = EdgeRate(pass, slot, &edges[j]);
+                pass->rates[next] = rate > pass->rates[next] ? rate : pass->rates[next];
+                pass->marks[next] |= EXTERNAL_ENTERED;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * This function checks if a person is reached and not calculated yet
+ * @param pass the state of the calculation
+ * @param slot the slot of the person
+ * @return 1 if the person is waiting, 0 otherwise
+ */
+int PendingPerson(const ExternalPass *pass, size_t slot){
+    return (pass->marks[slot] & (EXTERNAL_REACHED | EXTERNAL_CALCULATED)) == EXTERNAL_REACHED;
+}
+
+/**
+ * This function calculates the rate person_2 of an edge gets through it
+ * @param pass the state of the calculation
+ * @param slot the slot of person_1
+ * @param edge the edge
+ * @return the rate of person_2 through the meeting (at most 1)
+ */
+double EdgeRate(const ExternalPass *pass, size_t slot, const CsrEdge *edge){
+    double rate = pass->rates[slot]*SpreaderPolicyMeetingWeight(pass->policy, edge->measure, edge->distance) +
+                  SpreaderPolicyAgeAddition(pass->policy, pass->spreader_detector->people[edge->to]->age);
+    return rate > 1 ? 1 : rate;
+}
+
+/**
+ * This function compares two slots for qsort
+ * @param a the first slot
+ * @param b the second slot
+ * @return negative, 0 or positive
+ */
+int CompareSlots(const void *a, const void *b){
+    size_t slot_a = *(const size_t *) a, slot_b = *(const size_t *) b;
+    return (slot_a > slot_b) - (slot_a < slot_b);
+}
@@ -0,0 +1,157 @@
+#ifndef SPREADEREXTERNAL_H
+#define SPREADEREXTERNAL_H
+
+#include "SpreaderDetector.h"
+#include <stdint.h>
+
+/**
+ * ======================= external memory mode ========================
+ * For meetings files which do not fit in memory. The people are read into a spreader
+ * detector as usual (they are needed for the id index), but the meetings never become
+ * Meeting objects:
+ * - SpreaderExternalBuild parses the meetings file into edges (slot of person_1, slot of
+ *   person_2, measure, distance), spills them in runs sorted by the slot of person_1, and
+ *   merges the runs into a CSR file - a header, the offset of the edges of each slot, and
+ *   the edges themselves in slot order (the meetings of each person in file order).
+ * - SpreaderExternalCalculate streams the CSR file in frontier order: a breadth first pass
+ *   from the sick people finds the people they reach and how many reached people met each of
+ *   them, and a second pass calculates each person once all of them are calculated. Each
+ *   frontier is sorted by slot, so the edges are read forward in large windows. The people
+ *   left waiting are on (or after) a cycle of meetings - a last pass finds their cycles
+ *   (depth first, in small windows) and calculates each cycle as a whole.
+ * The rates are the rates of SpreaderDetectorCalculateInfectionChances (a person met by several
+ * reached people gets the highest of their rates, and a cycle follows its cycle rule).
+ * The memory is bounded by the people and the run / read buffers, not by the meetings.
+ * =====================================================================
+ */
+
+/**
+ * @def SPREADER_EXTERNAL_MAGIC
+ * the magic bytes at the beginning of a CSR file.
+ */
+#define SPREADER_EXTERNAL_MAGIC "SPRDCSR1"
+
+/**
+ * @def SPREADER_EXTERNAL_FAN_IN
+ * the number of runs merged at a time (a run is merged O(log_FAN_IN(runs)) times).
+ */
+#define SPREADER_EXTERNAL_FAN_IN 16UL
+
+/**
+ * @def SPREADER_EXTERNAL_IO_BUFFER
+ * the size (in bytes) of the stdio buffer of each run file.
+ */
+#define SPREADER_EXTERNAL_IO_BUFFER (256UL * 1024UL)
+
+/**
+ * @def SPREADER_EXTERNAL_DEFAULT_BUFFER
+ * the default size (in bytes) of the run buffer and of the read window.
+ */
+#define SPREADER_EXTERNAL_DEFAULT_BUFFER (64UL * 1024UL * 1024UL)
+
+/**
+ * @struct ExternalEdge
+ * A meeting in a run.
+ * @param from the slot of person_1.
+ * @param to the slot of person_2.
+ * @param measure the measure of the meeting.
+ * @param distance the distance of the meeting.
+ * @param sequence the line of the meeting in the meetings file.
+ */
+typedef struct ExternalEdge {
+  uint64_t from;
+  uint64_t to;
+  double measure;
+  double distance;
+  uint64_t sequence;
+} ExternalEdge;
+
+/**
+ * @struct CsrEdge
+ * A meeting in the CSR file (person_1 is the slot whose edges hold it).
+ * @param to the slot of person_2.
+ * @param measure the measure of the meeting.
+ * @param distance the distance of the meeting.
+ */
+typedef struct CsrEdge {
+  uint64_t to;
+  double measure;
+  double distance;
+} CsrEdge;
+
+/**
+ * @struct CsrHeader
+ * The header of a CSR file, followed by num_of_people + 1 offsets (uint64_t) and num_of_edges edges.
+ * @param magic SPREADER_EXTERNAL_MAGIC (without the '\0').
+ * @param num_of_people the number of people (slots).
+ * @param num_of_edges the number of edges.
+ */
+typedef struct CsrHeader {
+  char magic[8];
+  uint64_t num_of_people;
+  uint64_t num_of_edges;
+} CsrHeader;
+
+/**
+ * @struct SpreaderExternalGraph
+ * An open CSR file.
+ * @param fd the file descriptor of the file.
+ * @param num_of_people the number of people.
+ * @param num_of_edges the number of edges.
+ * @param offsets the first edge of each slot (num_of_people + 1 entries, in memory).
+ * @param edges_offset the position of the first edge in the file.
+ */
+typedef struct SpreaderExternalGraph {
+  int fd;
+  size_t num_of_people;
+  size_t num_of_edges;
+  uint64_t *offsets;
+  size_t edges_offset;
+} SpreaderExternalGraph;
+
+/**
+ * Parses the meetings file into a CSR file over the slots of the people of the spreader detector,
+ * holding at most run_bytes of meetings in memory. The runs are unlinked temporary files next to
+ * the CSR file. Like SpreaderDetectorReadMeetingsFile, stops at the first malformed line or meeting with
+ * an unknown person.
+ * The people of the spreader detector must not change (nor be reordered) until the CSR file is used.
+ * @param spreader_detector the spreader detector, with the people.
+ * @param meetings_path the path to the meetings file (plain, gzip or zstd - see InputStream.h).
+ * @param csr_path the path of the CSR file.
+ * @param run_bytes the size of the run buffer (0 - SPREADER_EXTERNAL_DEFAULT_BUFFER).
+ * @return 1 if the CSR file was built successfully, 0 otherwise.
+ * @if_fails returns 0.
+ * @assumption you can not assume anything.
+ */
+int SpreaderExternalBuild(SpreaderDetector *spreader_detector, const char *meetings_path,
+                          const char *csr_path, size_t run_bytes);
+
+/**
+ * Opens a CSR file built by SpreaderExternalBuild (reads its header and offsets).
+ * @param csr_path the path of the CSR file.
+ * @return pointer to dynamically allocated SpreaderExternalGraph.
+ * @if_fails returns NULL.
+ * @assumption you can not assume anything.
+ */
+SpreaderExternalGraph *SpreaderExternalOpen(const char *csr_path);
+
+/**
+ * Closes the given CSR file.
+ * @param p_graph pointer to dynamically allocated graph.
+ * @assumption you can not assume anything.
+ */
+void SpreaderExternalClose(SpreaderExternalGraph **p_graph);
+
+/**
+ * Calculates the infection rates of the people of the spreader detector over the meetings of the
+ * CSR file, and publishes them (see SpreaderDetectorPublishInfectionRates).
+ * @param spreader_detector the spreader detector the CSR file was built with.
+ * @param graph the CSR file.
+ * @param read_bytes the size of the read window (0 - SPREADER_EXTERNAL_DEFAULT_BUFFER).
+ * @return 1 if the rates were calculated successfully, 0 otherwise.
+ * @if_fails returns 0 (the file could not be read - nothing is published then).
+ * @assumption you can not assume anything.
+ */
+int SpreaderExternalCalculate(SpreaderDetector *spreader_detector, SpreaderExternalGraph *graph, size_t read_bytes);
+
+#endif //SPREADEREXTERNAL_H
@@ -0,0 +1,244 @@
+#include "SpreaderPolicy.h"
+#include <stdbool.h>
+#include "SpreaderAlloc.h"
+
+int CompareAgeBands(const void *a, const void *b);
+int CompareTiers(const void *a, const void *b);
+int ParsePolicyLine(SpreaderPolicy *policy, const char *line, int *has_bands, int *has_tiers);
+int AppendAgeBand(SpreaderPolicy *policy, size_t age, double addition);
+int AppendTier(SpreaderPolicy *policy, double threshold, const char *label);
+
+static AgeBand g_default_age_bands[] = {{AGE_THRESHOLD, INFECTION_RATE_ADDITION_DUE_TO_AGE}};
+static TreatmentTier g_default_tiers[] = {{MEDICAL_SUPERVISION_THRESHOLD, MEDICAL_SUPERVISION_LABEL},
+                                          {REGULAR_QUARANTINE_THRESHOLD, REGULAR_QUARANTINE_LABEL}};
+static const SpreaderPolicy g_default_policy = {g_default_age_bands, 1, g_default_tiers, 2,
+                                                CLEAN_LABEL, MIN_DISTANCE, MAX_MEASURE};
+
+
+/**
+ * Returns the default policy (the values in Constants.h).
+ * @return pointer to the default policy (static - must not be freed).
+ */
+const SpreaderPolicy *SpreaderPolicyDefault(){
+    return &g_default_policy;
+}
+
+/**
+ * Loads a policy from the given file (see the format above).
+ * @param path the path to the policy file.
+ * @return pointer to dynamically allocated SpreaderPolicy.
+ * @if_fails returns NULL (also on a malformed line).
+ * @assumption you can not assume anything.
+ */
+SpreaderPolicy *SpreaderPolicyLoad(const char *path){
+    if (!path){
+        return NULL;
+    }
+    FILE *file = fopen(path, "r");
+    if (!file){
+        return NULL;
+    }
+    SpreaderPolicy *policy = calloc(1, sizeof(SpreaderPolicy));
+    if (!policy){
+        fclose(file);
+        return NULL;
+    }
+    strcpy(policy->clean_label, g_default_policy.clean_label);
+    policy->min_distance = g_default_policy.min_distance;
+    policy->max_measure = g_default_policy.max_measure;
+
+    int has_bands = false, has_tiers = false;
+    char buffer[MAX_LEN_OF_LINE];
+    while (fgets(buffer, MAX_LEN_OF_LINE, file)) {
+        if (!ParsePolicyLine(policy, buffer, &has_bands, &has_tiers)){
+            SpreaderPolicyFree(&policy);
+            fclose(file);
+            return NULL;
+        }
+    }
+    fclose(file);
+
+    for (size_t i = 0; !has_bands && i < g_default_policy.num_of_age_bands; ++i) {
+        if (!AppendAgeBand(policy, g_default_age_bands[i].age, g_default_age_bands[i].addition)){
+            SpreaderPolicyFree(&policy);
+            return NULL;
+        }
+    }
+    for (size_t i = 0; !has_tiers && i < g_default_policy.num_of_tiers; ++i) {
+        if (!AppendTier(policy, g_default_tiers[i].threshold, g_default_tiers[i].label)){
+            SpreaderPolicyFree(&policy);
+            return NULL;
+        }
+    }
+    qsort(policy->age_bands, policy->num_of_age_bands, sizeof(AgeBand), CompareAgeBands);
+    qsort(policy->tiers, policy->num_of_tiers, sizeof(TreatmentTier), CompareTiers);
+    return policy;
+}
+
+/**
+ * This function applies a single line of a policy file to the policy
+ * @param policy the policy
+ * @param line the line
+ * @param has_bands output - set to true on an age_band line
+ * @param has_tiers output - set to true on a tier line
+ * @return true on success, false on a malformed line
+ */
+int ParsePolicyLine(SpreaderPolicy *policy, const char *line, int *has_bands, int *has_tiers){
+    char key[MAX_LEN_OF_LINE] = "", label[MAX_LEN_OF_LINE] = "";
+    if (sscanf(line, "%256s", key) != 1 || key[0] == '#'){
+        return true; // an empty line or a comment
+    }
+    if (strcmp(key, "min_distance") == 0){
+        return sscanf(line, "%*s %lf", &policy->min_distance) == 1 && policy->min_distance > 0;
+    }
+    if (strcmp(key, "max_measure") == 0){
+        return sscanf(line, "%*s %lf", &policy->max_measure) == 1 && policy->max_measure > 0;
+    }
+    if (strcmp(key, "age_band") == 0){
+        size_t age;
+        double addition;
+        *has_bands = true;
+        return sscanf(line, "%*s %zu %lf", &age, &addition) == 2 && AppendAgeBand(policy, age, addition);
+    }
+    if (strcmp(key, "tier") == 0){
+        double threshold;
+        *has_tiers = true;
+        return sscanf(line, "%*s %lf %256s", &threshold, label) == 2 &&
+               strlen(label) < SPREADER_POLICY_MAX_LABEL && AppendTier(policy, threshold, label);
+    }
+    if (strcmp(key, "clean") == 0){
+        if (sscanf(line, "%*s %256s", label) != 1 || strlen(label) >= SPREADER_POLICY_MAX_LABEL){
+            return false;
+        }
+        strcpy(policy->clean_label, label);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * This function appends an age band to the policy
+ * @param policy the policy
+ * @param age people older than age get the addition
+ * @param addition the addition of the band
+ * @return true on success, false otherwise
+ */
+int AppendAgeBand(SpreaderPolicy *policy, size_t age, double addition){
+    AgeBand *temp = realloc(policy->age_bands, (policy->num_of_age_bands + 1)*sizeof(AgeBand));
+    if (!temp) return false;
+    policy->age_bands = temp;
+    policy->age_bands[policy->num_of_age_bands].age = age;
+    policy->age_bands[policy->num_of_age_bands++].addition = addition;
+    return true;
+}
+
+/**
+ * This function appends a treatment tier to the policy
+ * @param policy the policy
+ * @param threshold people above the threshold get the treatment
+ * @param label the name of the treatment (shorter than SPREADER_POLICY_MAX_LABEL)
+ * @return true on success, false otherwise
+ */
+int AppendTier(SpreaderPolicy *policy, double threshold, const char *label){
+    TreatmentTier *temp = realloc(policy->tiers, (policy->num_of_tiers + 1)*sizeof(TreatmentTier));
+    if (!temp) return false;
+    policy->tiers = temp;
+    policy->tiers[policy->num_of_tiers].threshold = threshold;
+    strcpy(policy->tiers[policy->num_of_tiers++].label, label);
+    return true;
+}
+
+/**
+ * Frees the given policy.
+ * @param p_policy pointer to dynamically allocated policy.
+ * @assumption you can not assume anything.
+ */
+void SpreaderPolicyFree(SpreaderPolicy **p_policy){
+    if (!p_policy || !(*p_policy) || *p_policy == &g_default_policy){
+        return;
+    }
+    free((*p_policy)->age_bands);
+    free((*p_policy)->tiers);
+    free(*p_policy);
+    *p_policy = NULL;
+}
+
+/**
+ * Returns the infection rate addition of the given age.
+ * @param policy the policy.
+ * @param age the age.
+ * @return the addition (0 if no age band applies).
+ */
+double SpreaderPolicyAgeAddition(const SpreaderPolicy *policy, size_t age){
+    double addition = 0;
+    for (size_t i = 0; i < policy->num_of_age_bands && age > policy->age_bands[i].age; ++i) {
+        addition = policy->age_bands[i].addition;
+    }
+    return addition;
+}
+
+/**
+ * Returns the weight of a meeting - the factor of person_1's rate in person_2's rate.
+ * @param policy the policy.
+ * @param measure the measure of the meeting.
+ * @param distance the distance of the meeting.
+ * @return the weight of the meeting.
+ */
+double SpreaderPolicyMeetingWeight(const SpreaderPolicy *policy, double measure, double distance){
+    // people are never closer than min_distance - a closer meeting (even at distance 0) counts as at it
+    distance = distance < policy->min_distance ? policy->min_distance : distance;
+    return (measure*policy->min_distance)/(distance*policy->max_measure);
+}
+
+/**
+ * Returns the treatment tier of the given infection rate.
+ * @param policy the policy.
+ * @param rate the infection rate.
+ * @return the index of the tier, num_of_tiers if no tier applies.
+ */
+size_t SpreaderPolicyTier(const SpreaderPolicy *policy, double rate){
+    size_t tier = 0;
+    while (tier < policy->num_of_tiers && rate <= policy->tiers[tier].threshold) {
+        tier++;
+    }
+    return tier;
+}
+
+/**
+ * Returns the treatment of the given infection rate.
+ * @param policy the policy.
+ * @param rate the infection rate.
+ * @return the label of the treatment.
+ */
+const char *SpreaderPolicyTreatment(const SpreaderPolicy *policy, double rate){
+    size_t tier = SpreaderPolicyTier(policy, rate);
+    return tier < policy->num_of_tiers ? policy->tiers[tier].label : policy->clean_label;
+}
+
+/**
+ * The function is used to sort the age bands by age (ascending).
+ * @param a pointer to an age band
+ * @param b pointer to an age band
+ * @return negative if a should be before b, positive if after, 0 otherwise
+ */
+int CompareAgeBands(const void *a, const void *b){
+    const AgeBand *band_1 = a, *band_2 = b;
+    if (band_1->age < band_2->age){
+        return -1;
+    }
+    return band_1->age != band_2->age;
+}
+
+/**
+ * The function is used to sort the treatment tiers by threshold (descending).
+ * @param a pointer to a treatment tier
+ * @param b pointer to a treatment tier
+ * @return negative if a should be before b, positive if after, 0 otherwise
+ */
+int CompareTiers(const void *a, const void *b){
+    const TreatmentTier *tier_1 = a, *tier_2 = b;
+    if (tier_1->threshold > tier_2->threshold){
+        return -1;
+    }
+    return tier_1->threshold != tier_2->threshold;
+}
@@ -0,0 +1,126 @@
+#ifndef SPREADERPOLICY_H
+#define SPREADERPOLICY_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "Constants.h"
+
+/**
+ * ======================= policy file ========================
+ * One setting per line, '#' starts a comment line:
+ * min_distance <double>
+ * max_measure <double>
+ * age_band <age> <addition>       - people older than age get the addition
+ *                                   (the band with the highest age which applies).
+ * tier <threshold> <label>        - people whose rate is above the threshold get
+ *                                   the treatment (the tier with the highest threshold which applies).
+ * clean <label>                   - the treatment of people in no tier.
+ * Settings which do not appear keep their values from Constants.h; any age_band
+ * (tier) line replaces all the default age bands (tiers).
+ * ============================================================
+ */
+
+/**
+ * @def SPREADER_POLICY_MAX_LABEL
+ * the maximal length of a treatment label (including the '\0').
+ */
+#define SPREADER_POLICY_MAX_LABEL 32
+
+/**
+ * @struct AgeBand
+ * @param age people older than age get the addition.
+ * @param addition the infection rate addition of the band.
+ */
+typedef struct AgeBand {
+  size_t age;
+  double addition;
+} AgeBand;
+
+/**
+ * @struct TreatmentTier
+ * @param threshold people whose infection rate is above the threshold get the treatment.
+ * @param label the name of the treatment (printed in the report).
+ */
+typedef struct TreatmentTier {
+  double threshold;
+  char label[SPREADER_POLICY_MAX_LABEL];
+} TreatmentTier;
+
+/**
+ * @struct SpreaderPolicy
+ * The scoring policy of the spreader detector.
+ * @param age_bands the age bands, sorted by age (ascending).
+ * @param num_of_age_bands the number of age bands.
+ * @param tiers the treatment tiers, sorted by threshold (descending).
+ * @param num_of_tiers the number of treatment tiers.
+ * @param clean_label the treatment of people in no tier.
+ * @param min_distance minimal distance two people can be in.
+ * @param max_measure the maximal time two people can be seen together.
+ */
+typedef struct SpreaderPolicy {
+  AgeBand *age_bands;
+  size_t num_of_age_bands;
+  TreatmentTier *tiers;
+  size_t num_of_tiers;
+  char clean_label[SPREADER_POLICY_MAX_LABEL];
+  double min_distance;
+  double max_measure;
+} SpreaderPolicy;
+
+/**
+ * Returns the default policy (the values in Constants.h).
+ * @return pointer to the default policy (static - must not be freed).
+ */
+const SpreaderPolicy *SpreaderPolicyDefault();
+
+/**
+ * Loads a policy from the given file (see the format above).
+ * @param path the path to the policy file.
+ * @return pointer to dynamically allocated SpreaderPolicy.
+ * @if_fails returns NULL (also on a malformed line).
+ * @assumption you can not assume anything.
+ */
+SpreaderPolicy *SpreaderPolicyLoad(const char *path);
+
+/**
+ * Frees the given policy.
+ * @param p_policy pointer to dynamically allocated policy.
+ * @assumption you can not assume anything.
+ */
+void SpreaderPolicyFree(SpreaderPolicy **p_policy);
+
+/**
+ * Returns the infection rate addition of the given age.
+ * @param policy the policy.
+ * @param age the age.
+ * @return the addition (0 if no age band applies).
+ */
+double SpreaderPolicyAgeAddition(const SpreaderPolicy *policy, size_t age);
+
+/**
+ * Returns the weight of a meeting - the factor of person_1's rate in person_2's rate.
+ * @param policy the policy.
+ * @param measure the measure of the meeting.
+ * @param distance the distance of the meeting (a distance below min_distance, or 0, counts as min_distance).
+ * @return the weight of the meeting.
+ */
+double SpreaderPolicyMeetingWeight(const SpreaderPolicy *policy, double measure, double distance);
+
+/**
+ * Returns the treatment tier of the given infection rate.
+ * @param policy the policy.
+ * @param rate the infection rate.
+ * @return the index of the tier, num_of_tiers if no tier applies.
+ */
+size_t SpreaderPolicyTier(const SpreaderPolicy *policy, double rate);
+
+/**
+ * Returns the treatment of the given infection rate.
+ * @param policy the policy.
+ * @param rate the infection rate.
+ * @return the label of the treatment.
+ */
+const char *SpreaderPolicyTreatment(const SpreaderPolicy *policy, double rate);
+
+#endif //SPREADERPOLICY_H
@@ -0,0 +1,160 @@
+#define _GNU_SOURCE // MAP_ANONYMOUS, syscall
+#include "SpreaderRegion.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/**
+ * @def REGION_MPOL_INTERLEAVE
+ * MPOL_INTERLEAVE of <numaif.h> (which comes with libnuma).
+ */
+#define REGION_MPOL_INTERLEAVE 3
+
+/**
+ * @def REGION_ONLINE_NODES
+ * the list of the online NUMA nodes (e.g. "0-1,3").
+ */
+#define REGION_ONLINE_NODES "/sys/devices/system/node/online"
+
+size_t RoundUp(size_t bytes, size_t granule);
+int InterleaveRegion(SpreaderRegion *region);
+unsigned long ReadOnlineNodes();
+
+
+/**
+ * Reserves a region of (at least) the given size.
+ * @param region output - the region.
+ * @param bytes the size of the region.
+ * @param numa_policy the placement of the pages of the region.
+ * @return 1 if the region was reserved successfully, 0 otherwise.
+ * @if_fails returns 0 (the region is then empty).
+ * @assumption you can not assume anything.
+ */
+int SpreaderRegionReserve(SpreaderRegion *region, size_t bytes, SpreaderNumaPolicy numa_policy){
+    if (!region){
+        return 0;
+    }
+    memset(region, 0, sizeof(SpreaderRegion));
+    if (bytes == 0 || bytes > SIZE_MAX - 2*SPREADER_REGION_GRANULE){
+        return 0;
+    }
+    size_t size = RoundUp(bytes, SPREADER_REGION_GRANULE);
+    // reserve a granule more, and trim the ends - so the region starts at a huge page boundary
+    size_t mapped = size + SPREADER_REGION_GRANULE;
+    char *address = mmap(NULL, mapped, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (address == MAP_FAILED){
+        return 0;
+    }
+    char *base = (char *) RoundUp((size_t) address, SPREADER_REGION_GRANULE);
+    if (base > address){
+        munmap(address, (size_t) (base - address));
+    }
+    if (address + mapped > base + size){
+        munmap(base + size, (size_t) (address + mapped - (base + size)));
+    }
+    region->base = base;
+    region->reserved = size;
+#ifdef MADV_HUGEPAGE
+    region->huge_pages = madvise(base, size, MADV_HUGEPAGE) == 0;
+#endif
+    if (numa_policy == SPREADER_NUMA_INTERLEAVE){
+        region->interleaved = InterleaveRegion(region);
+    }
+    return 1;
+}
+
+/**
+ * Commits the beginning of the region, up to (at least) the given size.
+ * @param region the region.
+ * @param bytes the number of bytes which should be readable and writable.
+ * @return 1 if committed successfully, 0 otherwise.
+ * @if_fails returns 0 (more than reserved, or out of memory - the committed part is unchanged).
+ * @assumption you can not assume anything.
+ */
+int SpreaderRegionCommit(SpreaderRegion *region, size_t bytes){
+    if (!region || !region->base || bytes > region->reserved){
+        return 0;
+    }
+    if (bytes <= region->committed){
+        return 1;
+    }
+    // a huge page at a time - the pages themselves are allocated when first written
+    size_t committed = RoundUp(bytes, SPREADER_REGION_GRANULE);
+    committed = committed < region->reserved ? committed : region->reserved;
+    if (mprotect(region->base + region->committed, committed - region->committed, PROT_READ | PROT_WRITE) != 0){
+        return 0;
+    }
+    region->committed = committed;
+    return 1;
+}
+
+/**
+ * Releases the region (its content is lost).
+ * @param region the region.
+ * @assumption you can not assume anything.
+ */
+void SpreaderRegionRelease(SpreaderRegion *region){
+    if (!region || !region->base){
+        return;
+    }
+    munmap(region->base, region->reserved);
+    memset(region, 0, sizeof(SpreaderRegion));
+}
+
+/**
+ * This function rounds the given size up to a multiple of the granule
+ * @param bytes the size
+ * @param granule the granule (a power of 2)
+ * @return the rounded size
+ */
+size_t RoundUp(size_t bytes, size_t granule){
+    return (bytes + granule - 1) & ~(granule - 1);
+}
+
+/**
+ * This function sets the interleave policy of the region (for the pages not allocated yet)
+ * @param region the region
+ * @return 1 if the kernel accepted the policy, 0 otherwise (a single node, or no mbind)
+ */
+int InterleaveRegion(SpreaderRegion *region){
+#ifdef SYS_mbind
+    unsigned long nodes = ReadOnlineNodes();
+    if ((nodes & (nodes - 1)) == 0){
+        return 0; // at most one node - nothing to interleave
+    }
+    return syscall(SYS_mbind, region->base, region->reserved, REGION_MPOL_INTERLEAVE, &nodes,
+                   (unsigned long) SPREADER_REGION_MAX_NODES + 1, 0) == 0;
+#else
+    (void) region;
+    return 0;
+#endif
+}
+
+/**
+ * This function reads the online NUMA nodes (the first SPREADER_REGION_MAX_NODES of them)
+ * @return a mask of the online nodes (0 if they could not be read)
+ */
+unsigned long ReadOnlineNodes(){
+    FILE *file = fopen(REGION_ONLINE_NODES, "r");
+    if (!file){
+        return 0;
+    }
+    unsigned long nodes = 0;
+    unsigned first, last;
+    int count;
+    // a list of ranges and single nodes - "0-3,5"
+    while ((count = fscanf(file, "%u-%u", &first, &last)) >= 1) {
+        last = count == 2 ? last : first;
+        for (unsigned node = first; node <= last && node < SPREADER_REGION_MAX_NODES; ++node) {
+            nodes |= 1UL << node;
+        }
+        if (fgetc(file) != ','){
+            break;
+        }
+    }
+    fclose(file);
+    return nodes;
+}
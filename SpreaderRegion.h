@@ -0,0 +1,90 @@
+#ifndef SPREADERREGION_H
+#define SPREADERREGION_H
+
+#include <stdlib.h>
+
+/**
+ * ======================= regions ========================
+ * A region reserves address space for an array up front (without memory behind it),
+ * and commits it as the array grows - the array never moves, so growing it copies nothing.
+ * - The region is aligned to SPREADER_REGION_GRANULE and asks for transparent huge pages
+ *   (madvise(MADV_HUGEPAGE), where the kernel supports it), so a large array costs a TLB
+ *   entry per 2MB instead of per 4KB.
+ * - With SPREADER_NUMA_INTERLEAVE the pages are interleaved between the online NUMA nodes
+ *   (mbind, through the raw system call - no libnuma is needed), so the threads of all the
+ *   nodes read it at the same cost. With SPREADER_NUMA_FIRST_TOUCH a page is placed on the node
+ *   of the thread which writes it first (the default policy of the kernel).
+ * Both are hints - a kernel without them (or a container which forbids mbind) still gets a
+ * working region. Linux only.
+ * =========================================================
+ */
+
+/**
+ * @def SPREADER_REGION_GRANULE
+ * the alignment of a region, and the step it is committed in (a huge page).
+ */
+#define SPREADER_REGION_GRANULE (2UL * 1024UL * 1024UL)
+
+/**
+ * @def SPREADER_REGION_MAX_NODES
+ * the maximal number of NUMA nodes a region is interleaved between.
+ */
+#define SPREADER_REGION_MAX_NODES 64
+
+/**
+ * @enum SpreaderNumaPolicy
+ * The placement of the pages of a region between the NUMA nodes.
+ * @param SPREADER_NUMA_FIRST_TOUCH on the node of the thread which writes the page first.
+ * @param SPREADER_NUMA_INTERLEAVE interleaved between the online nodes, page by page.
+ */
+typedef enum SpreaderNumaPolicy {
+  SPREADER_NUMA_FIRST_TOUCH,
+  SPREADER_NUMA_INTERLEAVE
+} SpreaderNumaPolicy;
+
+/**
+ * @struct SpreaderRegion
+ * A reserved range of address space, committed from its beginning.
+ * @param base the beginning of the region (NULL - no region).
+ * @param reserved the size of the region (in bytes).
+ * @param committed the number of bytes which are readable and writable.
+ * @param huge_pages 1 if the kernel accepted the huge pages advice.
+ * @param interleaved 1 if the kernel accepted the interleave policy.
+ */
+typedef struct SpreaderRegion {
+  char *base;
+  size_t reserved;
+  size_t committed;
+  int huge_pages;
+  int interleaved;
+} SpreaderRegion;
+
+/**
+ * Reserves a region of (at least) the given size.
+ * @param region output - the region.
+ * @param bytes the size of the region.
+ * @param numa_policy the placement of the pages of the region.
+ * @return 1 if the region was reserved successfully, 0 otherwise.
+ * @if_fails returns 0 (the region is then empty).
+ * @assumption you can not assume anything.
+ */
+int SpreaderRegionReserve(SpreaderRegion *region, size_t bytes, SpreaderNumaPolicy numa_policy);
+
+/**
+ * Commits the beginning of the region, up to (at least) the given size.
+ * @param region the region.
+ * @param bytes the number of bytes which should be readable and writable.
+ * @return 1 if committed successfully, 0 otherwise.
+ * @if_fails returns 0 (more than reserved, or out of memory - the committed part is unchanged).
+ * @assumption you can not assume anything.
+ */
+int SpreaderRegionCommit(SpreaderRegion *region, size_t bytes);
+
+/**
+ * Releases the region (its content is lost).
+ * @param region the region.
+ * @assumption you can not assume anything.
+ */
+void SpreaderRegionRelease(SpreaderRegion *region);
+
+#endif //SPREADERREGION_H
@@ -0,0 +1,735 @@
+#define _GNU_SOURCE // accept4
+#include "SpreaderServer.h"
+#include "MeetingLine.h"
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "SpreaderAlloc.h"
+
+/**
+ * @struct SpreaderConnection
+ * A client connection.
+ * @param fd the socket of the connection.
+ * @param in the received bytes which were not handled yet.
+ * @param in_size the number of bytes in in.
+ * @param out the response bytes which were not sent yet.
+ * @param out_size the number of bytes in out.
+ * @param out_cap the capacity of out.
+ * @param out_sent the number of bytes of out which were already sent.
+ * @param events the epoll events the connection is registered for (0 - not registered).
+ * @param waiting 1 if an ADD request of the connection is in the ingest thread.
+ * @param closing 1 if the connection should be closed once it is not waiting.
+ */
+typedef struct SpreaderConnection {
+  int fd;
+  char in[SPREADER_SERVER_MAX_REQUEST];
+  size_t in_size;
+  char *out;
+  size_t out_size;
+  size_t out_cap;
+  size_t out_sent;
+  unsigned int events;
+  int waiting;
+  int closing;
+} SpreaderConnection;
+
+/**
+ * @struct SpreaderIngest
+ * An ADD request handed to the ingest thread.
+ * @param connection the connection which sent the request.
+ * @param id_1 the id of the first person in the meeting.
+ * @param id_2 the id of the second person in the meeting.
+ * @param distance the distance of the meeting.
+ * @param measure the measure of the meeting.
+ * @param result 1 if the meeting was added, 0 otherwise.
+ * @param next the next request in the queue.
+ */
+typedef struct SpreaderIngest {
+  SpreaderConnection *connection;
+  IdT id_1;
+  IdT id_2;
+  double distance;
+  double measure;
+  int result;
+  struct SpreaderIngest *next;
+} SpreaderIngest;
+
+/**
+ * @struct TopEntry
+ * A candidate of a TOP request.
+ * @param rate the infection rate of the person (from the snapshot).
+ * @param person the person.
+ */
+typedef struct TopEntry {
+  double rate;
+  Person *person;
+} TopEntry;
+
+void *IngestMeetings(void *arg);
+int AcceptConnections(SpreaderServer *server);
+void ReadConnection(SpreaderConnection *connection);
+void ServeConnection(SpreaderServer *server, SpreaderConnection *connection);
+int HandleRequest(SpreaderServer *server, SpreaderConnection *connection, char *line);
+void HandleTop(SpreaderServer *server, SpreaderConnection *connection, size_t k);
+void HandleReport(SpreaderServer *server, SpreaderConnection *connection, const char *path);
+void FinishIngests(SpreaderServer *server);
+int AppendResponse(SpreaderConnection *connection, const char *format, ...);
+void FlushConnection(SpreaderConnection *connection);
+void UpdateInterest(SpreaderServer *server, SpreaderConnection *connection);
+void CloseConnection(SpreaderServer *server, SpreaderConnection *connection);
+void SiftDown(TopEntry *heap, size_t size, size_t i);
+
+
+/**
+ * Creates a server over the given spreader detector, listening on the given unix socket path.
+ * An existing socket file in the path is replaced.
+ * @param spreader_detector the spreader detector to serve.
+ * @param socket_path the path of the unix socket.
+ * @return pointer to dynamically allocated SpreaderServer.
+ * @if_fails returns NULL.
+ * @assumption you can not assume anything.
+ */
+SpreaderServer *SpreaderServerAlloc(SpreaderDetector *spreader_detector, const char *socket_path){
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (!spreader_detector || !socket_path || strlen(socket_path) >= sizeof(address.sun_path)){
+        return NULL;
+    }
+    strcpy(address.sun_path, socket_path);
+    SpreaderServer *server = calloc(1, sizeof(SpreaderServer));
+    if (!server){
+        return NULL;
+    }
+    server->spreader_detector = spreader_detector;
+    atomic_init(&server->stop, false);
+    server->listen_fd = server->epoll_fd = server->event_fd = -1;
+    server->socket_path = malloc(strlen(socket_path) + 1);
+    if (!server->socket_path){
+        free(server);
+        return NULL;
+    }
+    strcpy(server->socket_path, socket_path);
+    server->batch_ids = malloc(SPREADER_SERVER_MAX_REQUEST / 2 * sizeof(IdT));
+    server->batch_rates = malloc(SPREADER_SERVER_MAX_REQUEST / 2 * sizeof(double));
+    // the ingest thread is not running yet - nothing changes the spreader detector
+    server->memory_valid = SpreaderDetectorMemoryReport(spreader_detector, &server->memory);
+    pthread_rwlock_init(&server->lock, NULL);
+    pthread_mutex_init(&server->queue_lock, NULL);
+    pthread_cond_init(&server->queue_cond, NULL);
+
+    unlink(socket_path);
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!server->batch_ids || !server->batch_rates ||
+        server->listen_fd < 0 || server->epoll_fd < 0 || server->event_fd < 0 ||
+        bind(server->listen_fd, (struct sockaddr *) &address, sizeof(address)) < 0 ||
+        listen(server->listen_fd, SOMAXCONN) < 0){
+        SpreaderServerFree(&server);
+        return NULL;
+    }
+    struct epoll_event listen_event = {.events = EPOLLIN, .data.fd = server->listen_fd};
+    struct epoll_event wake_event = {.events = EPOLLIN, .data.fd = server->event_fd};
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &listen_event) < 0 ||
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->event_fd, &wake_event) < 0 ||
+        pthread_create(&server->ingest_thread, NULL, IngestMeetings, server) != 0){
+        SpreaderServerFree(&server);
+        return NULL;
+    }
+    server->ingest_thread_started = true;
+    return server;
+}
+
+/**
+ * Runs the event loop until SpreaderServerStop is called (or SIGINT/SIGTERM
+ * when installed by the caller).
+ * @param server the server.
+ * @return 1 if the loop ended normally, 0 on error.
+ * @assumption you can not assume anything.
+ */
+int SpreaderServerRun(SpreaderServer *server){
+    if (!server){
+        return 0;
+    }
+    struct epoll_event events[SPREADER_SERVER_MAX_EVENTS];
+    while (!atomic_load(&server->stop)) {
+        int n = epoll_wait(server->epoll_fd, events, SPREADER_SERVER_MAX_EVENTS, -1);
+        if (n < 0){
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        for (int i = 0; i < n && !atomic_load(&server->stop); ++i) {
+            int fd = events[i].data.fd;
+            if (fd == server->listen_fd){
+                if (!AcceptConnections(server)) return 0;
+                continue;
+            }
+            if (fd == server->event_fd){
+                FinishIngests(server);
+                continue;
+            }
+            SpreaderConnection *connection = server->connections[fd];
+            if (!connection) continue;
+            if (events[i].events & EPOLLOUT){
+                FlushConnection(connection);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)){
+                ReadConnection(connection);
+                ServeConnection(server, connection);
+            }
+            if (connection->closing && !connection->waiting &&
+                connection->out_sent == connection->out_size){
+                CloseConnection(server, connection);
+                continue;
+            }
+            UpdateInterest(server, connection);
+        }
+    }
+    return 1;
+}
+
+/**
+ * Asks the event loop to stop. Safe to call from a signal handler.
+ * @param server the server.
+ */
+void SpreaderServerStop(SpreaderServer *server){
+    if (!server){
+        return;
+    }
+    atomic_store(&server->stop, true);
+    uint64_t one = 1;
+    if (write(server->event_fd, &one, sizeof(one)) < 0){
+        // the event fd is already signaled
+    }
+}
+
+/**
+ * Closes all the connections and frees the server (not the spreader detector).
+ * @param p_server pointer to dynamically allocated server.
+ * @assumption you can not assume anything.
+ */
+void SpreaderServerFree(SpreaderServer **p_server){
+    if (!p_server || !(*p_server)){
+        return;
+    }
+    SpreaderServer *server = *p_server;
+    if (server->ingest_thread_started){
+        pthread_mutex_lock(&server->queue_lock);
+        atomic_store(&server->stop, true);
+        pthread_cond_signal(&server->queue_cond);
+        pthread_mutex_unlock(&server->queue_lock);
+        pthread_join(server->ingest_thread, NULL);
+    }
+    for (SpreaderIngest *lists[] = {server->pending, server->done}, **list = lists; list < lists + 2; ++list) {
+        while (*list) {
+            SpreaderIngest *next = (*list)->next;
+            free(*list);
+            *list = next;
+        }
+    }
+    for (size_t fd = 0; fd < server->connections_cap; ++fd) {
+        if (server->connections[fd]){
+            server->connections[fd]->waiting = false;
+            CloseConnection(server, server->connections[fd]);
+        }
+    }
+    free(server->connections);
+    if (server->listen_fd >= 0){
+        close(server->listen_fd);
+        unlink(server->socket_path);
+    }
+    if (server->epoll_fd >= 0) close(server->epoll_fd);
+    if (server->event_fd >= 0) close(server->event_fd);
+    pthread_rwlock_destroy(&server->lock);
+    pthread_mutex_destroy(&server->queue_lock);
+    pthread_cond_destroy(&server->queue_cond);
+    free(server->socket_path);
+    free(server->batch_ids);
+    free(server->batch_rates);
+    free(server);
+    *p_server = NULL;
+}
+
+/**
+ * The ingest thread - takes all the pending ADD requests, inserts them under the
+ * write lock, recalculates the infection rates once for the whole batch (outside the
+ * lock - lookups keep reading the previous generation), publishes the memory report
+ * of the new generation under the write lock and hands the results back to the event loop.
+ * @param arg the server (SpreaderServer *)
+ * @return NULL
+ */
+void *IngestMeetings(void *arg){
+    SpreaderServer *server = arg;
+    SpreaderDetector *spreader_detector = server->spreader_detector;
+    pthread_mutex_lock(&server->queue_lock);
+    while (!atomic_load(&server->stop)) {
+        if (!server->pending){
+            pthread_cond_wait(&server->queue_cond, &server->queue_lock);
+            continue;
+        }
+        // the pending queue is pushed at its front - reverse it to the arrival order
+        SpreaderIngest *batch = NULL, *last = server->pending;
+        while (server->pending) {
+            SpreaderIngest *next = server->pending->next;
+            server->pending->next = batch;
+            batch = server->pending;
+            server->pending = next;
+        }
+        pthread_mutex_unlock(&server->queue_lock);
+
+        int added = false;
+        pthread_rwlock_wrlock(&server->lock);
+        for (SpreaderIngest *ingest = batch; ingest; ingest = ingest->next) {
+            Person *person_1 = SpreaderDetectorGetPersonById(spreader_detector, ingest->id_1);
+            Person *person_2 = SpreaderDetectorGetPersonById(spreader_detector, ingest->id_2);
+            Meeting *meeting = person_1 && person_2 ?
+                               MeetingAlloc(person_1, person_2, ingest->measure, ingest->distance) : NULL;
+            ingest->result = meeting && SpreaderDetectorAddMeeting(spreader_detector, meeting);
+            if (!ingest->result){
+                MeetingFree(&meeting);
+            }
+            added |= ingest->result;
+        }
+        pthread_rwlock_unlock(&server->lock);
+        if (added){
+            SpreaderDetectorCalculateInfectionChances(spreader_detector);
+            // the calculation resizes its scratch - the report is taken here, not by the event loop
+            SpreaderMemoryReport memory;
+            int memory_valid = SpreaderDetectorMemoryReport(spreader_detector, &memory);
+            pthread_rwlock_wrlock(&server->lock);
+            server->memory = memory;
+            server->memory_valid = memory_valid;
+            pthread_rwlock_unlock(&server->lock);
+        }
+
+        pthread_mutex_lock(&server->queue_lock);
+        last->next = server->done;
+        server->done = batch;
+        uint64_t one = 1;
+        if (write(server->event_fd, &one, sizeof(one)) < 0){
+            // the event fd is already signaled
+        }
+    }
+    pthread_mutex_unlock(&server->queue_lock);
+    return NULL;
+}
+
+/**
+ * This function accepts all the waiting connections
+ * @param server the server
+ * @return true on success, false on a fatal error
+ */
+int AcceptConnections(SpreaderServer *server){
+    while (true) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0){
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            // EMFILE and friends drop the connection attempt, not the server
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EMFILE || errno == ENFILE;
+        }
+        if ((size_t) fd >= server->connections_cap){
+            size_t capacity = server->connections_cap == 0 ? SPREADER_DETECTOR_INITIAL_SIZE :
+                              server->connections_cap;
+            while (capacity <= (size_t) fd) {
+                capacity *= SPREADER_DETECTOR_GROWTH_FACTOR;
+            }
+            SpreaderConnection **temp = realloc(server->connections, capacity*sizeof(void *));
+            if (!temp){
+                close(fd);
+                continue;
+            }
+            memset(temp + server->connections_cap, 0, (capacity - server->connections_cap)*sizeof(void *));
+            server->connections = temp;
+            server->connections_cap = capacity;
+        }
+        SpreaderConnection *connection = calloc(1, sizeof(SpreaderConnection));
+        if (!connection){
+            close(fd);
+            continue;
+        }
+        connection->fd = fd;
+        server->connections[fd] = connection;
+        UpdateInterest(server, connection);
+    }
+}
+
+/**
+ * This function reads everything the connection has sent (as long as there is room
+ * for it), and marks the connection for closing at the end of its input
+ * @param connection the connection
+ */
+void ReadConnection(SpreaderConnection *connection){
+    while (connection->in_size < SPREADER_SERVER_MAX_REQUEST) {
+        ssize_t n = read(connection->fd, connection->in + connection->in_size,
+                         SPREADER_SERVER_MAX_REQUEST - connection->in_size);
+        if (n > 0){
+            connection->in_size += (size_t) n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)){
+            connection->closing = true;
+        }
+        return;
+    }
+}
+
+/**
+ * This function handles every complete request line of the connection, stopping
+ * at an ADD request until the ingest thread finishes it (to keep the responses in order)
+ * @param server the server
+ * @param connection the connection
+ */
+void ServeConnection(SpreaderServer *server, SpreaderConnection *connection){
+    size_t start = 0;
+    pthread_rwlock_rdlock(&server->lock);
+    while (!connection->waiting) {
+        char *line = connection->in + start;
+        char *new_line = memchr(line, '\n', connection->in_size - start);
+        if (!new_line) break;
+        *new_line = '\0';
+        start = (size_t) (new_line - connection->in) + 1;
+        if (!HandleRequest(server, connection, line)){
+            connection->closing = true;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&server->lock);
+
+    if (start == 0 && connection->in_size == SPREADER_SERVER_MAX_REQUEST && !connection->waiting){
+        // a request longer than the buffer
+        AppendResponse(connection, "ERR\n");
+        connection->closing = true;
+        connection->in_size = 0;
+    }
+    memmove(connection->in, connection->in + start, connection->in_size - start);
+    connection->in_size -= start;
+    FlushConnection(connection);
+}
+
+/**
+ * This function handles a single request line (under the read lock)
+ * @param server the server
+ * @param connection the connection which sent the request
+ * @param line the request (without the '\n')
+ * @return true if the connection should stay open, false otherwise
+ */
+int HandleRequest(SpreaderServer *server, SpreaderConnection *connection, char *line){
+    SpreaderDetector *spreader_detector = server->spreader_detector;
+    char command[8] = "";
+    int offset = 0;
+    if (sscanf(line, "%7s%n", command, &offset) != 1){
+        return AppendResponse(connection, "ERR\n");
+    }
+    char *args = line + offset;
+
+    if (strcmp(command, "GET") == 0){
+        IdT id;
+        if (sscanf(args, "%zu", &id) != 1) return AppendResponse(connection, "ERR\n");
+        return AppendResponse(connection, "%lf\n", SpreaderDetectorGetInfectionRateById(spreader_detector, id));
+    }
+    if (strcmp(command, "MGET") == 0){
+        // each id takes at least 2 bytes of the line, so the batch arrays always have room
+        size_t num_of_ids = 0;
+        char *end;
+        for (IdT id = strtoull(args, &end, 10); end != args; id = strtoull(args, &end, 10)) {
+            server->batch_ids[num_of_ids++] = id;
+            args = end;
+        }
+        // all the rates of a batch come from the same generation
+        SpreaderDetectorGetInfectionRatesByIds(spreader_detector, server->batch_ids, num_of_ids, server->batch_rates);
+        for (size_t i = 0; i < num_of_ids; ++i) {
+            if (!AppendResponse(connection, i + 1 < num_of_ids ? "%lf " : "%lf", server->batch_rates[i])){
+                return false;
+            }
+        }
+        return AppendResponse(connection, "\n");
+    }
+    if (strcmp(command, "TOP") == 0){
+        size_t k;
+        if (sscanf(args, "%zu", &k) != 1) return AppendResponse(connection, "ERR\n");
+        HandleTop(server, connection, k);
+        return true;
+    }
+    if (strcmp(command, "REPORT") == 0){
+        char path[MAX_LEN_OF_LINE] = "";
+        sscanf(args, "%256s", path);
+        HandleReport(server, connection, path);
+        return true;
+    }
+    if (strcmp(command, "MEMORY") == 0){
+        // the report of the last calculation - the ingest thread may be calculating right now
+        const SpreaderMemoryReport report = server->memory;
+        if (!server->memory_valid) return AppendResponse(connection, "ERR\n");
+        return AppendResponse(connection, "%zu %zu %zu %zu %zu %zu\n", report.total, report.people + report.names,
+                              report.meetings, report.person_meetings + report.people_array + report.meetings_array,
+                              report.indices + report.columns,
+                              report.person_meetings_slack + report.people_array_slack +
+                              report.meetings_array_slack + report.columns_slack);
+    }
+    if (strcmp(command, "ADD") == 0){
+        SpreaderIngest *ingest = calloc(1, sizeof(SpreaderIngest));
+        if (!ingest) return AppendResponse(connection, "ERR\n");
+        MeetingLine line;
+        if (!MeetingLineParse(args, strlen(args) + 1, &line)){
+            free(ingest);
+            return AppendResponse(connection, "ERR\n");
+        }
+        ingest->id_1 = line.id_1;
+        ingest->id_2 = line.id_2;
+        ingest->distance = line.distance;
+        ingest->measure = line.measure;
+        ingest->connection = connection;
+        connection->waiting = true;
+        pthread_mutex_lock(&server->queue_lock);
+        ingest->next = server->pending;
+        server->pending = ingest;
+        pthread_cond_signal(&server->queue_cond);
+        pthread_mutex_unlock(&server->queue_lock);
+        return true;
+    }
+    return AppendResponse(connection, "ERR\n");
+}
+
+/**
+ * This function answers a TOP request - the k people with the highest infection
+ * rate in the published generation, selected with a min-heap of size k
+ * @param server the server
+ * @param connection the connection which sent the request
+ * @param k the number of people to return
+ */
+void HandleTop(SpreaderServer *server, SpreaderConnection *connection, size_t k){
+    SpreaderDetector *spreader_detector = server->spreader_detector;
+    if (k > spreader_detector->people_size) k = spreader_detector->people_size;
+    if (k > SPREADER_SERVER_MAX_TOP) k = SPREADER_SERVER_MAX_TOP;
+    TopEntry *heap = malloc((k + 1)*sizeof(TopEntry));
+    if (!heap){
+        AppendResponse(connection, "ERR\n");
+        return;
+    }
+    const RateSnapshot *snapshot = SpreaderDetectorAcquireRates(spreader_detector);
+    size_t size = 0;
+    for (size_t i = 0; i < spreader_detector->people_size && k > 0; ++i) {
+        Person *person = spreader_detector->people[i];
+        TopEntry entry = {snapshot && i < snapshot->size ? snapshot->rates[i] : person->infection_rate, person};
+        if (size < k){
+            heap[size++] = entry;
+            if (size == k){
+                for (size_t j = k / 2; j-- > 0;) {
+                    SiftDown(heap, size, j);
+                }
+            }
+        }
+        else if (entry.rate > heap[0].rate){
+            heap[0] = entry;
+            SiftDown(heap, size, 0);
+        }
+    }
+    SpreaderDetectorReleaseRates(spreader_detector, snapshot);
+    if (size < k){
+        for (size_t j = size / 2; j-- > 0;) {
+            SiftDown(heap, size, j);
+        }
+    }
+    // pop the minimum to the end, leaving the array sorted from the highest rate
+    for (size_t end = size; end > 1; --end) {
+        TopEntry temp = heap[0];
+        heap[0] = heap[end - 1];
+        heap[end - 1] = temp;
+        SiftDown(heap, end - 1, 0);
+    }
+    for (size_t i = 0; i < size; ++i) {
+        AppendResponse(connection, i + 1 < size ? "%zu:%lf " : "%zu:%lf", heap[i].person->id, heap[i].rate);
+    }
+    AppendResponse(connection, "\n");
+    free(heap);
+}
+
+/**
+ * This function restores the min-heap (by infection rate) below the given index
+ * @param heap the heap
+ * @param size the size of the heap
+ * @param i the index to sift down
+ */
+void SiftDown(TopEntry *heap, size_t size, size_t i){
+    while (2*i + 1 < size) {
+        size_t child = 2*i + 1;
+        if (child + 1 < size && heap[child + 1].rate < heap[child].rate){
+            child++;
+        }
+        if (heap[i].rate <= heap[child].rate) return;
+        TopEntry temp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = temp;
+        i = child;
+    }
+}
+
+/**
+ * This function answers a REPORT request - writes the report to the given path,
+ * or returns the number of people in each treatment tier (and then with no
+ * treatment) when no path is given
+ * @param server the server
+ * @param connection the connection which sent the request
+ * @param path the output path (may be empty)
+ */
+void HandleReport(SpreaderServer *server, SpreaderConnection *connection, const char *path){
+    SpreaderDetector *spreader_detector = server->spreader_detector;
+    if (path[0]){
+        int success = SpreaderDetectorPrintRecommendTreatmentToAll(spreader_detector, path);
+        AppendResponse(connection, success ? "OK\n" : "ERR\n");
+        return;
+    }
+    const SpreaderPolicy *policy = SpreaderDetectorGetPolicy(spreader_detector);
+    size_t *counts = calloc(policy->num_of_tiers + 1, sizeof(size_t));
+    if (!counts){
+        AppendResponse(connection, "ERR\n");
+        return;
+    }
+    const RateSnapshot *snapshot = SpreaderDetectorAcquireRates(spreader_detector);
+    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
+        double rate = snapshot && i < snapshot->size ? snapshot->rates[i] : spreader_detector->people[i]->infection_rate;
+        counts[SpreaderPolicyTier(policy, rate)]++;
+    }
+    SpreaderDetectorReleaseRates(spreader_detector, snapshot);
+    for (size_t i = 0; i <= policy->num_of_tiers; ++i) {
+        AppendResponse(connection, i < policy->num_of_tiers ? "%zu " : "%zu\n", counts[i]);
+    }
+    free(counts);
+}
+
+/**
+ * This function answers the ADD requests the ingest thread finished, and resumes
+ * their connections
+ * @param server the server
+ */
+void FinishIngests(SpreaderServer *server){
+    uint64_t count;
+    if (read(server->event_fd, &count, sizeof(count)) < 0){
+        // nothing to read - handled below anyway
+    }
+    pthread_mutex_lock(&server->queue_lock);
+    SpreaderIngest *done = server->done;
+    server->done = NULL;
+    pthread_mutex_unlock(&server->queue_lock);
+
+    while (done) {
+        SpreaderIngest *next = done->next;
+        SpreaderConnection *connection = done->connection;
+        connection->waiting = false;
+        AppendResponse(connection, done->result ? "OK\n" : "ERR\n");
+        free(done);
+        done = next;
+        if (!connection->closing){
+            ServeConnection(server, connection);
+        }
+        else {
+            FlushConnection(connection);
+        }
+        if (connection->closing && !connection->waiting &&
+            connection->out_sent == connection->out_size){
+            CloseConnection(server, connection);
+        }
+        else {
+            UpdateInterest(server, connection);
+        }
+    }
+}
+
+/**
+ * This function appends a formatted response to the output of the connection
+ * @param connection the connection
+ * @param format the printf format of the response
+ * @return true on success, false if the response could not be allocated
+ */
+int AppendResponse(SpreaderConnection *connection, const char *format, ...){
+    while (true) {
+        va_list args;
+        va_start(args, format);
+        size_t room = connection->out_cap - connection->out_size;
+        int n = vsnprintf(connection->out ? connection->out + connection->out_size : NULL, room, format, args);
+        va_end(args);
+        if (n < 0) return false;
+        if ((size_t) n < room){
+            connection->out_size += (size_t) n;
+            return true;
+        }
+        size_t capacity = connection->out_cap == 0 ? MAX_LEN_OF_LINE : connection->out_cap;
+        while (capacity - connection->out_size <= (size_t) n) {
+            capacity *= SPREADER_DETECTOR_GROWTH_FACTOR;
+        }
+        char *temp = realloc(connection->out, capacity);
+        if (!temp) return false;
+        connection->out = temp;
+        connection->out_cap = capacity;
+    }
+}
+
+/**
+ * This function sends as much of the pending output of the connection as the socket takes
+ * @param connection the connection
+ */
+void FlushConnection(SpreaderConnection *connection){
+    while (connection->out_sent < connection->out_size) {
+        ssize_t n = send(connection->fd, connection->out + connection->out_sent,
+                         connection->out_size - connection->out_sent, MSG_NOSIGNAL);
+        if (n > 0){
+            connection->out_sent += (size_t) n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        // the peer is gone - drop the output
+        connection->closing = true;
+        connection->out_sent = connection->out_size;
+    }
+    if (connection->out_sent == connection->out_size){
+        connection->out_sent = connection->out_size = 0;
+    }
+}
+
+/**
+ * This function registers the connection for the epoll events it needs - no input
+ * while it waits for the ingest thread or is closing, and output only when some is pending
+ * @param server the server
+ * @param connection the connection
+ */
+void UpdateInterest(SpreaderServer *server, SpreaderConnection *connection){
+    unsigned int events = 0;
+    if (!connection->waiting && !connection->closing) events |= EPOLLIN;
+    if (connection->out_sent < connection->out_size) events |= EPOLLOUT;
+    if (events == connection->events) return;
+
+    struct epoll_event event = {.events = events, .data.fd = connection->fd};
+    if (events == 0){
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+    }
+    else {
+        epoll_ctl(server->epoll_fd, connection->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, connection->fd, &event);
+    }
+    connection->events = events;
+}
+
+/**
+ * This function closes the connection; a connection that waits for the ingest
+ * thread keeps its fd until the ADD request is finished
+ * @param server the server
+ * @param connection the connection
+ */
+void CloseConnection(SpreaderServer *server, SpreaderConnection *connection){
+    connection->closing = true;
+    if (connection->waiting){
+        UpdateInterest(server, connection);
+        return;
+    }
+    server->connections[connection->fd] = NULL;
+    close(connection->fd);
+    free(connection->out);
+    free(connection);
+}
@@ -0,0 +1,127 @@
+#ifndef SPREADERSERVER_H
+#define SPREADERSERVER_H
+
+#include "SpreaderDetector.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+/**
+ * ======================= protocol ========================
+ * One request per line, one response line per request (in request order):
+ * GET <id>                            -> <rate> (-1 if no such person)
+ * MGET <id> <id> ...                  -> <rate> <rate> ...
+ * TOP <k>                             -> <id>:<rate> ... (highest rate first)
+ * ADD <id_1> <id_2> <distance> <measure> -> OK | ERR (after the rates were updated)
+ * REPORT                              -> <count> ... (per treatment tier of the policy,
+ *                                        highest first, then no treatment)
+ * REPORT <path>                       -> OK | ERR (SpreaderDetectorPrintRecommendTreatmentToAll)
+ * MEMORY                              -> <total> <people> <meetings> <arrays> <indices> <slack>
+ *                                        (bytes, see SpreaderDetectorMemoryReport - as of the
+ *                                        last calculation)
+ * Anything else                       -> ERR
+ * =========================================================
+ */
+
+/**
+ * @def SPREADER_SERVER_MAX_EVENTS
+ * the maximal number of events handled in one epoll_wait call.
+ */
+#define SPREADER_SERVER_MAX_EVENTS 64
+
+/**
+ * @def SPREADER_SERVER_MAX_REQUEST
+ * the maximal length of a request line (including the '\n').
+ */
+#define SPREADER_SERVER_MAX_REQUEST 65536UL
+
+/**
+ * @def SPREADER_SERVER_MAX_TOP
+ * the maximal k of a TOP request.
+ */
+#define SPREADER_SERVER_MAX_TOP 4096UL
+
+/**
+ * @struct SpreaderServer
+ * A daemon which serves queries over a loaded spreader detector.
+ * Lookups are answered on the event loop thread from the published rate
+ * snapshot, under a read lock over the people and meetings; ADD requests are
+ * handed to an ingest thread which takes the write lock only to insert, and
+ * recalculates outside of it.
+ * @param spreader_detector the served spreader detector (not owned).
+ * @param socket_path the path of the unix socket (removed by SpreaderServerFree).
+ * @param listen_fd the listening unix socket.
+ * @param epoll_fd the epoll instance.
+ * @param event_fd wakes the event loop when the ingest thread finished a request.
+ * @param lock the reader/writer lock over the spreader detector.
+ * @param connections the open connections (indexed by fd).
+ * @param connections_cap the capacity of the connections array.
+ * @param pending the queue of ADD requests waiting for the ingest thread.
+ * @param done the queue of ADD requests the ingest thread finished.
+ * @param queue_lock protects pending and done.
+ * @param queue_cond signals the ingest thread.
+ * @param ingest_thread the ingest thread.
+ * @param ingest_thread_started 1 if the ingest thread was started.
+ * @param batch_ids the ids of an MGET request.
+ * @param batch_rates the rates of an MGET request.
+ * @param memory the memory report of the last calculation (taken by the ingest thread,
+ * which alone changes the spreader detector, and published under the write lock).
+ * @param memory_valid 1 if the memory report was taken successfully.
+ * @param stop true if the server is shutting down (lock free - SpreaderServerStop may set it from a
+ * signal handler, and the event loop and the ingest thread read it).
+ */
+typedef struct SpreaderServer {
+  SpreaderDetector *spreader_detector;
+  char *socket_path;
+  int listen_fd;
+  int epoll_fd;
+  int event_fd;
+  pthread_rwlock_t lock;
+  struct SpreaderConnection **connections;
+  size_t connections_cap;
+  struct SpreaderIngest *pending;
+  struct SpreaderIngest *done;
+  pthread_mutex_t queue_lock;
+  pthread_cond_t queue_cond;
+  pthread_t ingest_thread;
+  int ingest_thread_started;
+  IdT *batch_ids;
+  double *batch_rates;
+  SpreaderMemoryReport memory;
+  int memory_valid;
+  atomic_bool stop;
+} SpreaderServer;
+
+/**
+ * Creates a server over the given spreader detector, listening on the given unix socket path.
+ * An existing socket file in the path is replaced.
+ * @param spreader_detector the spreader detector to serve.
+ * @param socket_path the path of the unix socket.
+ * @return pointer to dynamically allocated SpreaderServer.
+ * @if_fails returns NULL.
+ * @assumption you can not assume anything.
+ */
+SpreaderServer *SpreaderServerAlloc(SpreaderDetector *spreader_detector, const char *socket_path);
+
+/**
+ * Runs the event loop until SpreaderServerStop is called (or SIGINT/SIGTERM
+ * when installed by the caller).
+ * @param server the server.
+ * @return 1 if the loop ended normally, 0 on error.
+ * @assumption you can not assume anything.
+ */
+int SpreaderServerRun(SpreaderServer *server);
+
+/**
+ * Asks the event loop to stop. Safe to call from a signal handler.
+ * @param server the server.
+ */
+void SpreaderServerStop(SpreaderServer *server);
+
+/**
+ * Closes all the connections and frees the server (not the spreader detector).
+ * @param p_server pointer to dynamically allocated server.
+ * @assumption you can not assume anything.
+ */
+void SpreaderServerFree(SpreaderServer **p_server);
+
+#endif //SPREADERSERVER_H
@@ -0,0 +1,1127 @@
+#define _GNU_SOURCE // MAP_ANONYMOUS, pthread_barrier_t
+#include "SpreaderShards.h"
+#include "InputStream.h"
+#include "MeetingLine.h"
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "SpreaderAlloc.h"
+
+/**
+ * @def SHARD_ALIGNMENT
+ * the alignment of the areas of the shared memory (a cache line, so the rings of
+ * different shards do not share one).
+ */
+#define SHARD_ALIGNMENT 64UL
+
+/**
+ * @def SHARD_MAX_REPORT_LINE
+ * the maximal length of a line of a shard report (a name, three numbers and a label).
+ */
+#define SHARD_MAX_REPORT_LINE (2 * MAX_LEN_OF_LINE)
+
+/**
+ * @def SHARD_UNREACHED
+ * the state of a person no sick person reaches (yet).
+ */
+#define SHARD_UNREACHED 0
+
+/**
+ * @def SHARD_REACHED
+ * the state of a person a sick person reaches, whose rate is not calculated yet.
+ */
+#define SHARD_REACHED 1
+
+/**
+ * @def SHARD_CALCULATED
+ * the state of a reached person whose rate is final.
+ */
+#define SHARD_CALCULATED 2
+
+/**
+ * @enum ShardPhase
+ * The phases of a sharded run (see SpreaderShards.h).
+ * @param SHARD_PHASE_REACH the people the sick people reach are marked.
+ * @param SHARD_PHASE_RATE the rates of the reached people are calculated.
+ */
+typedef enum ShardPhase {
+  SHARD_PHASE_REACH,
+  SHARD_PHASE_RATE
+} ShardPhase;
+
+/**
+ * @struct ShardWaitingPerson
+ * A person the rate phase left waiting, in the cycles file of his/her shard.
+ * @param id the id of the person.
+ * @param age the age of the person.
+ * @param is_sick 1 if the person is sick.
+ * @param entered 1 if a calculated person met the person.
+ * @param rate the highest rate the calculated people who met the person gave (1 if sick).
+ */
+typedef struct ShardWaitingPerson {
+  IdT id;
+  size_t age;
+  int is_sick;
+  int entered;
+  double rate;
+} ShardWaitingPerson;
+
+/**
+ * @struct ShardWaitingMeeting
+ * A meeting between two waiting people, in the cycles file of the shard of person_2.
+ * @param id_1 the id of person_1.
+ * @param id_2 the id of person_2.
+ * @param measure the measure of the meeting.
+ * @param distance the distance of the meeting.
+ */
+typedef struct ShardWaitingMeeting {
+  IdT id_1;
+  IdT id_2;
+  double measure;
+  double distance;
+} ShardWaitingMeeting;
+
+/**
+ * @struct ShardWaitingRate
+ * The rate shard 0 calculated for a waiting person.
+ * @param id the id of the person.
+ * @param rate the infection rate of the person.
+ */
+typedef struct ShardWaitingRate {
+  IdT id;
+  double rate;
+} ShardWaitingRate;
+
+/**
+ * @struct ShardControl
+ * The state the workers share (at the beginning of the shared memory).
+ * @param barrier the barrier between the phases of a round (process shared).
+ * @param sent the number of messages sent in the current round of the phase (by round parity).
+ * @param failed 1 if a worker failed - all the workers stop after the current round.
+ * @param messages the number of messages sent in all the rounds.
+ * @param waiting the number of people the rate phase left waiting (on or after a cycle), in all the shards.
+ * @param rounds the number of rounds of both phases (written by shard 0).
+ * @param num_of_shards the number of shards.
+ */
+typedef struct ShardControl {
+  pthread_barrier_t barrier;
+  atomic_size_t sent[2];
+  atomic_int failed;
+  atomic_size_t messages;
+  atomic_size_t waiting;
+  size_t rounds;
+  size_t num_of_shards;
+} ShardControl;
+
+/**
+ * @struct ShardOutbound
+ * A person of the shard who met someone of another shard.
+ * @param source the person.
+ * @param shard the other shard.
+ */
+typedef struct ShardOutbound {
+  Person *source;
+  size_t shard;
+} ShardOutbound;
+
+/**
+ * @struct ShardWorker
+ * The state of a single worker process.
+ * @param control the shared state.
+ * @param rings the rings of all the pairs of shards (sending shard major).
+ * @param messages the messages area of the rings.
+ * @param shard the shard of the worker.
+ * @param spreader_detector the local spreader detector - the people of the shard first
+ * (in the order of the people file), then the ghosts.
+ * @param num_of_local the number of people of the shard.
+ * @param outbound the people of the shard who met people of other shards (one entry per other
+ * shard, by slot of the person).
+ * @param num_of_outbound the number of outbound entries.
+ * @param outbound_cap the capacity of outbound.
+ * @param outbound_offsets the first outbound entry of each person of the shard (by slot, and
+ * num_of_outbound at num_of_local).
+ * @param states the state of each person (by slot) - SHARD_UNREACHED, SHARD_REACHED or
+ * SHARD_CALCULATED.
+ * @param remaining the number of reached people who met each person and are not calculated yet.
+ * @param entered 1 if a calculated person met the person (by slot).
+ * @param stack the people the worker advances next (each is pushed once per phase).
+ * @param stack_size the number of people in the stack.
+ */
+typedef struct ShardWorker {
+  ShardControl *control;
+  ShardRing *rings;
+  ShardMessage *messages;
+  size_t shard;
+  SpreaderDetector *spreader_detector;
+  size_t num_of_local;
+  ShardOutbound *outbound;
+  size_t num_of_outbound;
+  size_t outbound_cap;
+  size_t *outbound_offsets;
+  unsigned char *states;
+  size_t *remaining;
+  unsigned char *entered;
+  size_t *stack;
+  size_t stack_size;
+} ShardWorker;
+
+size_t ShardOf(IdT id, size_t num_of_shards);
+size_t AlignShared(size_t size);
+int CountCrossMeetings(const char *meetings_path, size_t num_of_shards, size_t *counts);
+int RunWorker(ShardWorker *worker, const char *people_path, const char *meetings_path,
+              const SpreaderPolicy *policy, const char *output_path);
+int LoadShardPeople(ShardWorker *worker, const char *path);
+int LoadShardMeetings(ShardWorker *worker, const char *path);
+int AddOutbound(ShardWorker *worker, Person *source, size_t shard);
+int CompareOutbound(const void *a, const void *b);
+void IndexOutbound(ShardWorker *worker);
+int RunPhase(ShardWorker *worker, ShardPhase phase, int success, size_t *rounds);
+void StartReach(ShardWorker *worker);
+void StartRates(ShardWorker *worker);
+void PushPerson(ShardWorker *worker, size_t slot, unsigned char state);
+int AdvancePeople(ShardWorker *worker, ShardPhase phase, size_t parity);
+int SendPerson(ShardWorker *worker, const Person *person, size_t *sent);
+void ReceiveBoundary(ShardWorker *worker, ShardPhase phase);
+int AllCalculated(const ShardWorker *worker);
+int CalculateCycles(ShardWorker *worker, const SpreaderPolicy *policy, const char *output_path, int success);
+size_t CountWaiting(const ShardWorker *worker);
+int WriteWaiting(const ShardWorker *worker, const char *path);
+int CalculateWaiting(size_t num_of_shards, const SpreaderPolicy *policy, const char *output_path);
+int ReadWaiting(SpreaderDetector *spreader_detector, const char *path, int meetings);
+int ApplyWaitingRates(ShardWorker *worker, const char *path);
+void GetShardCyclesPath(const char *output_path, size_t shard, char *path, size_t size);
+int SameReports(const char *path_1, const char *path_2);
+void FreeShardDetector(SpreaderDetector **p_spreader_detector);
+int WriteShardReport(ShardWorker *worker, const SpreaderPolicy *policy, const char *path);
+int MergeReports(const char *people_path, const char *output_path, size_t num_of_shards);
+void GetShardReportPath(const char *output_path, size_t shard, char *path, size_t size);
+void FreeShardWorker(ShardWorker *worker);
+
+
+/**
+ * Calculates the infection rates of the people in the given files with the given number of
+ * worker processes, and prints the recommendation for treatment of all the people to the given
+ * output path (in the order of the people file, as SpreaderDetectorPrintRecommendTreatmentToAll).
+ * Each worker also writes its part of the report to <output_path>.<shard>, and its people on a cycle
+ * to <output_path>.<shard>.cycles (removed after the merge).
+ * @param people_path the path to the people file (plain, gzip or zstd - see InputStream.h).
+ * @param meetings_path the path to the meetings file (plain, gzip or zstd).
+ * @param num_of_shards the number of worker processes (1 to SPREADER_SHARDS_MAX_SHARDS).
+ * @param policy the scoring policy (NULL for SpreaderPolicyDefault).
+ * @param output_path the path to the output file.
+ * @param stats output - the statistics of the run (may be NULL).
+ * @return 1 if the report was printed successfully, 0 otherwise.
+ * @if_fails returns 0 (a worker failed, or the rounds did not converge).
+ * @assumption you can not assume anything.
+ */
+int SpreaderShardsRun(const char *people_path, const char *meetings_path, size_t num_of_shards,
+                      const SpreaderPolicy *policy, const char *output_path, SpreaderShardsStats *stats){
+    if (!people_path || !meetings_path || !output_path ||
+        num_of_shards == 0 || num_of_shards > SPREADER_SHARDS_MAX_SHARDS){
+        return 0;
+    }
+    // the rings are sized to the meetings between each pair of shards - a round never sends
+    // more than one message per meeting
+    size_t *counts = calloc(num_of_shards*num_of_shards, sizeof(size_t));
+    if (!counts || !CountCrossMeetings(meetings_path, num_of_shards, counts)){
+        free(counts);
+        return 0;
+    }
+    size_t num_of_messages = 0;
+    for (size_t i = 0; i < num_of_shards*num_of_shards; ++i) {
+        num_of_messages += counts[i];
+    }
+    size_t rings_offset = AlignShared(sizeof(ShardControl));
+    size_t messages_offset = rings_offset + AlignShared(num_of_shards*num_of_shards*sizeof(ShardRing));
+    size_t shared_size = messages_offset + (num_of_messages + 1)*sizeof(ShardMessage);
+    char *shared = mmap(NULL, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED){
+        free(counts);
+        return 0;
+    }
+
+    ShardControl *control = (ShardControl *) shared;
+    ShardRing *rings = (ShardRing *) (shared + rings_offset);
+    pthread_barrierattr_t attributes;
+    pthread_barrierattr_init(&attributes);
+    pthread_barrierattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    int success = pthread_barrier_init(&control->barrier, &attributes, (unsigned) num_of_shards) == 0;
+    pthread_barrierattr_destroy(&attributes);
+    if (!success){
+        munmap(shared, shared_size);
+        free(counts);
+        return 0;
+    }
+    atomic_init(&control->sent[0], 0);
+    atomic_init(&control->sent[1], 0);
+    atomic_init(&control->failed, 0);
+    atomic_init(&control->messages, 0);
+    atomic_init(&control->waiting, 0);
+    control->num_of_shards = num_of_shards;
+    for (size_t i = 0, offset = 0; i < num_of_shards*num_of_shards; ++i) {
+        atomic_init(&rings[i].head, 0);
+        atomic_init(&rings[i].tail, 0);
+        rings[i].capacity = counts[i];
+        rings[i].offset = offset;
+        offset += counts[i];
+    }
+
+    // the workers inherit the buffers of the standard streams
+    fflush(NULL);
+    pid_t pids[SPREADER_SHARDS_MAX_SHARDS];
+    size_t started = 0;
+    for (; started < num_of_shards; ++started) {
+        pids[started] = fork();
+        if (pids[started] < 0){
+            break;
+        }
+        if (pids[started] == 0){
+            ShardWorker worker = {.control = control, .rings = rings,
+                                  .messages = (ShardMessage *) (shared + messages_offset), .shard = started};
+            _exit(RunWorker(&worker, people_path, meetings_path, policy, output_path));
+        }
+    }
+    if (started < num_of_shards){
+        // the started workers would wait for the others at the barrier forever
+        for (size_t i = 0; i < started; ++i) {
+            kill(pids[i], SIGKILL);
+        }
+        success = false;
+    }
+    for (size_t i = 0; i < started; ++i) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS){
+            if (success && pid >= 0 && !WIFEXITED(status)){
+                // a crashed worker never reaches the barrier
+                for (size_t j = 0; j < started; ++j) {
+                    kill(pids[j], SIGKILL);
+                }
+            }
+            success = false;
+        }
+    }
+
+    success = success && MergeReports(people_path, output_path, num_of_shards);
+    char path[MAX_LEN_OF_LINE + 32];
+    for (size_t i = 0; i < num_of_shards; ++i) {
+        GetShardReportPath(output_path, i, path, sizeof(path));
+        remove(path);
+    }
+    for (size_t i = 0; i <= num_of_shards; ++i) {
+        GetShardCyclesPath(output_path, i, path, sizeof(path));
+        remove(path);
+    }
+    if (stats){
+        stats->rounds = control->rounds;
+        stats->messages = atomic_load(&control->messages);
+        stats->cross_meetings = num_of_messages;
+        stats->cycle_people = atomic_load(&control->waiting);
+    }
+    pthread_barrier_destroy(&control->barrier);
+    munmap(shared, shared_size);
+    free(counts);
+    return success;
+}
+
+int SpreaderShardsCheck(const char *people_path, const char *meetings_path, const SpreaderPolicy *policy,
+                        const char *output_path){
+    char path[MAX_LEN_OF_LINE + 32];
+    snprintf(path, sizeof(path), "%s.check", output_path);
+    SpreaderDetector *spreader_detector = SpreaderDetectorAlloc();
+    int success = spreader_detector &&
+                  SpreaderDetectorReadPeopleFile(spreader_detector, people_path) &&
+                  SpreaderDetectorSetPolicy(spreader_detector, policy) &&
+                  SpreaderDetectorReadMeetingsFile(spreader_detector, meetings_path);
+    if (success){
+        SpreaderDetectorCalculateInfectionChances(spreader_detector);
+        success = SpreaderDetectorPrintRecommendTreatmentToAll(spreader_detector, path) &&
+                  SameReports(output_path, path);
+    }
+    remove(path);
+    FreeShardDetector(&spreader_detector);
+    return success;
+}
+
+/**
+ * This function returns the shard of the given id (Fibonacci hashing, as the id index)
+ * @param id the id
+ * @param num_of_shards the number of shards
+ * @return the shard of the id
+ */
+size_t ShardOf(IdT id, size_t num_of_shards){
+    return (size_t) (((unsigned long long) id * 0x9E3779B97F4A7C15ULL) >> 32U) % num_of_shards;
+}
+
+/**
+ * This function rounds the given size up to SHARD_ALIGNMENT
+ * @param size the size
+ * @return the aligned size
+ */
+size_t AlignShared(size_t size){
+    return (size + SHARD_ALIGNMENT - 1) / SHARD_ALIGNMENT * SHARD_ALIGNMENT;
+}
+
+/**
+ * This function counts the meetings between each pair of shards (up to the first malformed line,
+ * where the meetings file ends for every reader)
+ * @param meetings_path the path to the meetings file
+ * @param num_of_shards the number of shards
+ * @param counts output - the number of meetings from the shard of person_1 to the shard of
+ * person_2 (sending shard major, 0 for a shard with itself)
+ * @return true on success, false otherwise
+ */
+int CountCrossMeetings(const char *meetings_path, size_t num_of_shards, size_t *counts){
+    InputStream *file = InputStreamOpen(meetings_path);
+    if (!file){
+        return false;
+    }
+    char buffer[MAX_LEN_OF_LINE];
+    while (InputStreamGetLine(file, buffer, MAX_LEN_OF_LINE)) {
+        MeetingLine line;
+        if (!MeetingLineParse(buffer, MAX_LEN_OF_LINE, &line)) break;
+        size_t shard_1 = ShardOf(line.id_1, num_of_shards), shard_2 = ShardOf(line.id_2, num_of_shards);
+        if (shard_1 != shard_2){
+            counts[shard_1*num_of_shards + shard_2]++;
+        }
+    }
+    int success = !InputStreamHasError(file);
+    InputStreamClose(&file);
+    return success;
+}
+
+/**
+ * The worker process - loads the shard, runs the rounds with the other workers,
+ * and writes the report of the shard
+ * @param worker the worker (with the shared memory and the shard)
+ * @param people_path the path to the people file
+ * @param meetings_path the path to the meetings file
+ * @param policy the scoring policy (NULL for SpreaderPolicyDefault)
+ * @param output_path the path to the output file
+ * @return the exit status of the worker
+ */
+int RunWorker(ShardWorker *worker, const char *people_path, const char *meetings_path,
+              const SpreaderPolicy *policy, const char *output_path){
+    worker->spreader_detector = SpreaderDetectorAlloc();
+    int success = worker->spreader_detector && LoadShardPeople(worker, people_path) &&
+                  LoadShardMeetings(worker, meetings_path) &&
+                  SpreaderDetectorSetPolicy(worker->spreader_detector, policy);
+    if (success){
+        size_t size = worker->spreader_detector->people_size;
+        worker->outbound_offsets = malloc((worker->num_of_local + 1)*sizeof(size_t));
+        worker->states = calloc(size + 1, sizeof(unsigned char));
+        worker->remaining = calloc(size + 1, sizeof(size_t));
+        worker->entered = calloc(size + 1, sizeof(unsigned char));
+        worker->stack = malloc((size + 1)*sizeof(size_t));
+        success = worker->outbound_offsets && worker->states && worker->remaining && worker->entered &&
+                  worker->stack;
+    }
+    if (success){
+        IndexOutbound(worker);
+        StartReach(worker);
+    }
+
+    // a failed worker keeps taking part in the rounds, so nobody waits for it
+    size_t rounds = 0;
+    success = RunPhase(worker, SHARD_PHASE_REACH, success, &rounds);
+    if (success){
+        StartRates(worker);
+    }
+    success = RunPhase(worker, SHARD_PHASE_RATE, success, &rounds);
+    if (worker->shard == 0){
+        worker->control->rounds = rounds;
+    }
+    success = CalculateCycles(worker, policy, output_path, success);
+
+    char path[MAX_LEN_OF_LINE + 32];
+    GetShardReportPath(output_path, worker->shard, path, sizeof(path));
+    success = success && AllCalculated(worker) && WriteShardReport(worker, policy, path);
+    FreeShardWorker(worker);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * This function runs the rounds of a phase with the other workers, until a round sends no message
+ * (a person sends each message once, so this always happens)
+ * @param worker the worker
+ * @param phase the phase
+ * @param success false if the worker already failed (it still takes part in the rounds)
+ * @param rounds the number of rounds run so far - advanced by the rounds of the phase
+ * @return true on success, false if any of the workers failed
+ */
+int RunPhase(ShardWorker *worker, ShardPhase phase, int success, size_t *rounds){
+    ShardControl *control = worker->control;
+    if (worker->shard == 0){
+        atomic_store(&control->sent[0], 0);
+        atomic_store(&control->sent[1], 0);
+    }
+    pthread_barrier_wait(&control->barrier);
+    for (size_t round = 0;; ++round) {
+        size_t parity = round % 2;
+        if (success && !atomic_load(&control->failed)){
+            success = AdvancePeople(worker, phase, parity);
+        }
+        if (!success){
+            atomic_store(&control->failed, 1);
+        }
+        pthread_barrier_wait(&control->barrier);
+
+        // every worker sees the same counts here, so all of them leave in the same round
+        if (atomic_load(&control->failed) || atomic_load(&control->sent[parity]) == 0){
+            *rounds += round + 1;
+            return !atomic_load(&control->failed);
+        }
+        ReceiveBoundary(worker, phase);
+        if (worker->shard == 0){
+            atomic_store(&control->sent[1 - parity], 0);
+        }
+        pthread_barrier_wait(&control->barrier);
+    }
+}
+
+/**
+ * This function reads the people of the shard from the people file
+ * @param worker the worker
+ * @param path the path to the people file
+ * @return true on success, false otherwise
+ */
+int LoadShardPeople(ShardWorker *worker, const char *path){
+    InputStream *file = InputStreamOpen(path);
+    if (!file){
+        return false;
+    }
+    size_t num_of_shards = worker->control->num_of_shards;
+    char buffer[MAX_LEN_OF_LINE];
+    int success = true;
+    while (success && InputStreamGetLine(file, buffer, MAX_LEN_OF_LINE)) {
+        char name[MAX_LEN_OF_LINE], sick[MAX_LEN_OF_LINE] = "";
+        IdT id;
+        size_t age;
+        sscanf(buffer, "%s %zu %zu %s", name, &id, &age, sick);
+        if (ShardOf(id, num_of_shards) != worker->shard) continue;
+        char *pName = malloc(strlen(name) + 1);
+        Person *person = pName ? PersonAlloc(id, strcpy(pName, name), age, strcmp(sick, "SICK") == 0) : NULL;
+        success = person && SpreaderDetectorAddPerson(worker->spreader_detector, person);
+        if (!success){
+            if (person) PersonFree(&person);
+            else free(pName);
+        }
+    }
+    success = success && !InputStreamHasError(file);
+    InputStreamClose(&file);
+    worker->num_of_local = worker->spreader_detector->people_size;
+    return success;
+}
+
+/**
+ * This function reads the meetings of the shard from the meetings file - the meetings between
+ * its people, the meetings of people of other shards with its people (from a ghost), and the
+ * people of the shard who met people of other shards (outbound) - up to the first malformed line
+ * @param worker the worker
+ * @param path the path to the meetings file
+ * @return true on success, false otherwise
+ */
+int LoadShardMeetings(ShardWorker *worker, const char *path){
+    InputStream *file = InputStreamOpen(path);
+    if (!file){
+        return false;
+    }
+    SpreaderDetector *spreader_detector = worker->spreader_detector;
+    size_t num_of_shards = worker->control->num_of_shards;
+    char buffer[MAX_LEN_OF_LINE];
+    int success = true;
+    while (success && InputStreamGetLine(file, buffer, MAX_LEN_OF_LINE)) {
+        MeetingLine line;
+        if (!MeetingLineParse(buffer, MAX_LEN_OF_LINE, &line)) break;
+        size_t shard_1 = ShardOf(line.id_1, num_of_shards), shard_2 = ShardOf(line.id_2, num_of_shards);
+        if (shard_1 == worker->shard && shard_2 != worker->shard){
+            Person *source = SpreaderDetectorGetPersonById(spreader_detector, line.id_1);
+            success = source && AddOutbound(worker, source, shard_2);
+            continue;
+        }
+        if (shard_2 != worker->shard) continue;
+        Person *p1 = SpreaderDetectorGetPersonById(spreader_detector, line.id_1);
+        Person *p2 = SpreaderDetectorGetPersonById(spreader_detector, line.id_2);
+        if (!p1 && shard_1 != worker->shard){
+            // the ghost of a person of another shard - never sick, the messages reach it and set its rate
+            p1 = PersonAlloc(line.id_1, NULL, 0, 0);
+            if (p1 && !SpreaderDetectorAddPerson(spreader_detector, p1)){
+                PersonFree(&p1);
+            }
+        }
+        Meeting *meeting = p1 && p2 ? MeetingAlloc(p1, p2, line.measure, line.distance) : NULL;
+        success = meeting && SpreaderDetectorAddMeeting(spreader_detector, meeting);
+        if (!success){
+            MeetingFree(&meeting);
+        }
+    }
+    success = success && !InputStreamHasError(file);
+    InputStreamClose(&file);
+    if (!success){
+        return false;
+    }
+    // one message per person and other shard is enough
+    if (worker->num_of_outbound > 0){
+        qsort(worker->outbound, worker->num_of_outbound, sizeof(ShardOutbound), CompareOutbound);
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < worker->num_of_outbound; ++i) {
+        if (size == 0 || worker->outbound[i].source != worker->outbound[size - 1].source ||
+            worker->outbound[i].shard != worker->outbound[size - 1].shard){
+            worker->outbound[size++] = worker->outbound[i];
+        }
+    }
+    worker->num_of_outbound = size;
+    return true;
+}
+
+/**
+ * This function appends an outbound entry to the worker (nothing was sent for it yet)
+ * @param worker the worker
+ * @param source the person of the shard
+ * @param shard the other shard
+ * @return true on success, false otherwise
+ */
+int AddOutbound(ShardWorker *worker, Person *source, size_t shard){
+    if (worker->num_of_outbound == worker->outbound_cap){
+        size_t capacity = worker->outbound_cap == 0 ? SPREADER_DETECTOR_INITIAL_SIZE :
+                          worker->outbound_cap * SPREADER_DETECTOR_GROWTH_FACTOR;
+        ShardOutbound *temp = realloc(worker->outbound, capacity*sizeof(ShardOutbound));
+        if (!temp) return false;
+        worker->outbound = temp;
+        worker->outbound_cap = capacity;
+    }
+    ShardOutbound outbound = {.source = source, .shard = shard};
+    worker->outbound[worker->num_of_outbound++] = outbound;
+    return true;
+}
+
+/**
+ * The function is used to sort the outbound entries by person slot and shard.
+ * @param a pointer to an outbound entry
+ * @param b pointer to an outbound entry
+ * @return negative if a should be before b, positive if after, 0 otherwise
+ */
+int CompareOutbound(const void *a, const void *b){
+    const ShardOutbound *outbound_1 = a, *outbound_2 = b;
+    if (outbound_1->source->slot != outbound_2->source->slot){
+        return outbound_1->source->slot < outbound_2->source->slot ? -1 : 1;
+    }
+    if (outbound_1->shard < outbound_2->shard){
+        return -1;
+    }
+    return outbound_1->shard != outbound_2->shard;
+}
+
+/**
+ * This function finds the first outbound entry of each person of the shard (the entries are
+ * sorted by slot)
+ * @param worker the worker
+ */
+void IndexOutbound(ShardWorker *worker){
+    size_t entry = 0;
+    for (size_t i = 0; i <= worker->num_of_local; ++i) {
+        while (entry < worker->num_of_outbound && worker->outbound[entry].source->slot < i) {
+            entry++;
+        }
+        worker->outbound_offsets[i] = entry;
+    }
+}
+
+/**
+ * This function starts the reach phase from the sick people of the shard
+ * @param worker the worker
+ */
+void StartReach(ShardWorker *worker){
+    for (size_t i = 0; i < worker->num_of_local; ++i) {
+        if (worker->spreader_detector->people[i]->is_sick){
+            PushPerson(worker, i, SHARD_REACHED);
+        }
+    }
+}
+
+/**
+ * This function starts the rate phase - counts the reached people who met each person, and
+ * starts from the sick people of the shard no reached person met (the ghosts start when their
+ * rates are received)
+ * @param worker the worker
+ */
+void StartRates(ShardWorker *worker){
+    SpreaderDetector *spreader_detector = worker->spreader_detector;
+    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
+        Person *person = spreader_detector->people[i];
+        person->infection_rate = person->is_sick ? 1 : 0;
+        if (worker->states[i] == SHARD_UNREACHED) continue;
+        for (size_t j = 0; j < person->num_of_meetings; ++j) {
+            worker->remaining[person->meetings[j]->person_2->slot]++;
+        }
+    }
+    for (size_t i = 0; i < worker->num_of_local; ++i) {
+        if (worker->states[i] == SHARD_REACHED && worker->remaining[i] == 0){
+            PushPerson(worker, i, SHARD_CALCULATED);
+        }
+    }
+}
+
+/**
+ * This function sets the state of a person and pushes him/her to the stack
+ * @param worker the worker
+ * @param slot the slot of the person
+ * @param state the new state of the person
+ */
+void PushPerson(ShardWorker *worker, size_t slot, unsigned char state){
+    worker->states[slot] = state;
+    worker->stack[worker->stack_size++] = slot;
+}
+
+/**
+ * This function advances the people of the stack (and the people they push) - sends the people of
+ * the shard to the shards where they met someone, and passes the phase on to the people they met:
+ * the reach phase reaches them, the rate phase gives them the highest rate, and pushes them once
+ * all the reached people who met them are calculated
+ * @param worker the worker
+ * @param phase the phase
+ * @param parity the parity of the round (the counter of its messages)
+ * @return true on success, false otherwise (a ring is full)
+ */
+int AdvancePeople(ShardWorker *worker, ShardPhase phase, size_t parity){
+    const SpreaderPolicy *policy = SpreaderDetectorGetPolicy(worker->spreader_detector);
+    size_t sent = 0;
+    int success = true;
+    while (success && worker->stack_size > 0) {
+        size_t slot = worker->stack[--worker->stack_size];
+        const Person *person = worker->spreader_detector->people[slot];
+        success = slot >= worker->num_of_local || SendPerson(worker, person, &sent);
+        for (size_t i = 0; i < person->num_of_meetings; ++i) {
+            const Meeting *meeting = person->meetings[i];
+            size_t to = meeting->person_2->slot;
+            if (phase == SHARD_PHASE_REACH){
+                if (worker->states[to] == SHARD_UNREACHED){
+                    PushPerson(worker, to, SHARD_REACHED);
+                }
+                continue;
+            }
+            double rate = person->infection_rate*SpreaderPolicyMeetingWeight(policy, meeting->measure,
+                                                                             meeting->distance) +
+                          SpreaderPolicyAgeAddition(policy, meeting->person_2->age);
+            rate = rate > 1 ? 1 : rate;
+            if (rate > meeting->person_2->infection_rate){
+                meeting->person_2->infection_rate = rate;
+            }
+            worker->entered[to] = true;
+            if (--worker->remaining[to] == 0){
+                PushPerson(worker, to, SHARD_CALCULATED);
+            }
+        }
+    }
+    atomic_fetch_add(&worker->control->sent[parity], sent);
+    atomic_fetch_add(&worker->control->messages, sent);
+    return success;
+}
+
+/**
+ * This function sends a person of the shard (and his/her rate) to the shards where he/she met someone
+ * @param worker the worker
+ * @param person the person
+ * @param sent the number of messages sent in the round - advanced by the messages sent
+ * @return true on success, false otherwise (a ring is full)
+ */
+int SendPerson(ShardWorker *worker, const Person *person, size_t *sent){
+    size_t num_of_shards = worker->control->num_of_shards;
+    size_t end = worker->outbound_offsets[person->slot + 1];
+    for (size_t i = worker->outbound_offsets[person->slot]; i < end; ++i) {
+        ShardRing *ring = &worker->rings[worker->shard*num_of_shards + worker->outbound[i].shard];
+        size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) == ring->capacity){
+            return false;
+        }
+        ShardMessage *message = &worker->messages[ring->offset + head % ring->capacity];
+        message->id = person->id;
+        message->rate = person->infection_rate;
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+        (*sent)++;
+    }
+    return true;
+}
+
+/**
+ * This function applies the messages the other shards sent to the ghosts of the shard, and pushes
+ * them - the reach phase reaches the ghost, the rate phase sets its final rate
+ * (a ghost is never sick - the sick person it stands for sends 1)
+ * @param worker the worker
+ * @param phase the phase
+ */
+void ReceiveBoundary(ShardWorker *worker, ShardPhase phase){
+    size_t num_of_shards = worker->control->num_of_shards;
+    unsigned char from = phase == SHARD_PHASE_REACH ? SHARD_UNREACHED : SHARD_REACHED;
+    unsigned char to = phase == SHARD_PHASE_REACH ? SHARD_REACHED : SHARD_CALCULATED;
+    for (size_t shard = 0; shard < num_of_shards; ++shard) {
+        ShardRing *ring = &worker->rings[shard*num_of_shards + worker->shard];
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        for (; tail != head; ++tail) {
+            const ShardMessage *message = &worker->messages[ring->offset + tail % ring->capacity];
+            Person *ghost = SpreaderDetectorGetPersonById(worker->spreader_detector, message->id);
+            if (!ghost || ghost->slot < worker->num_of_local || worker->states[ghost->slot] != from){
+                continue;
+            }
+            if (phase == SHARD_PHASE_RATE){
+                ghost->infection_rate = message->rate;
+            }
+            PushPerson(worker, ghost->slot, to);
+        }
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+}
+
+/**
+ * This function checks that the rates of all the reached people of the shard were calculated
+ * @param worker the worker
+ * @return true if they were, false otherwise (shard 0 did not send a waiting person back)
+ */
+int AllCalculated(const ShardWorker *worker){
+    for (size_t i = 0; i < worker->num_of_local; ++i) {
+        if (worker->states[i] == SHARD_REACHED){
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * This function calculates the people the rate phase left waiting in all the shards - they are on
+ * a cycle of meetings, or after one. Each worker writes its waiting people and the meetings between
+ * them to its cycles file, shard 0 calculates all of them together with the cycle rule of
+ * SpreaderDetectorCalculateInfectionChances, and each worker takes the rates of its people back
+ * @param worker the worker
+ * @param policy the scoring policy (NULL for SpreaderPolicyDefault)
+ * @param output_path the path to the output file (the cycles files are created next to it)
+ * @param success false if the worker already failed (it still takes part in the barriers)
+ * @return true on success, false if any of the workers failed
+ */
+int CalculateCycles(ShardWorker *worker, const SpreaderPolicy *policy, const char *output_path, int success){
+    ShardControl *control = worker->control;
+    char path[MAX_LEN_OF_LINE + 32];
+    if (success){
+        atomic_fetch_add(&control->waiting, CountWaiting(worker));
+    }
+    pthread_barrier_wait(&control->barrier);
+    // every worker sees the same count here, so all of them take the same barriers
+    if (atomic_load(&control->waiting) == 0){
+        return success && !atomic_load(&control->failed);
+    }
+    GetShardCyclesPath(output_path, worker->shard, path, sizeof(path));
+    if (!success || atomic_load(&control->failed) || !WriteWaiting(worker, path)){
+        atomic_store(&control->failed, 1);
+    }
+    pthread_barrier_wait(&control->barrier);
+    if (worker->shard == 0 && !atomic_load(&control->failed) &&
+        !CalculateWaiting(control->num_of_shards, policy, output_path)){
+        atomic_store(&control->failed, 1);
+    }
+    pthread_barrier_wait(&control->barrier);
+    GetShardCyclesPath(output_path, control->num_of_shards, path, sizeof(path));
+    return !atomic_load(&control->failed) && ApplyWaitingRates(worker, path);
+}
+
+/**
+ * This function counts the people of the shard the rate phase left waiting
+ * @param worker the worker
+ * @return the number of waiting people
+ */
+size_t CountWaiting(const ShardWorker *worker){
+    size_t waiting = 0;
+    for (size_t i = 0; i < worker->num_of_local; ++i) {
+        waiting += worker->states[i] == SHARD_REACHED;
+    }
+    return waiting;
+}
+
+/**
+ * This function writes the cycles file of the shard - the number of its waiting people, the people,
+ * and the meetings of waiting people with them (the ghosts which wait stand for people of other
+ * shards who wait)
+ * @param worker the worker
+ * @param path the path of the cycles file of the shard
+ * @return true on success, false otherwise
+ */
+int WriteWaiting(const ShardWorker *worker, const char *path){
+    FILE *file = fopen(path, "wb");
+    if (!file){
+        return false;
+    }
+    const SpreaderDetector *spreader_detector = worker->spreader_detector;
+    size_t waiting = CountWaiting(worker);
+    int success = fwrite(&waiting, sizeof(size_t), 1, file) == 1;
+    for (size_t i = 0; success && i < worker->num_of_local; ++i) {
+        const Person *person = spreader_detector->people[i];
+        if (worker->states[i] != SHARD_REACHED) continue;
+        ShardWaitingPerson record = {.id = person->id, .age = person->age, .is_sick = person->is_sick != 0,
+                                     .entered = worker->entered[i], .rate = person->infection_rate};
+        success = fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+    for (size_t i = 0; success && i < spreader_detector->people_size; ++i) {
+        const Person *person = spreader_detector->people[i];
+        if (worker->states[i] != SHARD_REACHED) continue;
+        for (size_t j = 0; success && j < person->num_of_meetings; ++j) {
+            const Meeting *meeting = person->meetings[j];
+            if (worker->states[meeting->person_2->slot] != SHARD_REACHED) continue;
+            ShardWaitingMeeting record = {.id_1 = person->id, .id_2 = meeting->person_2->id,
+                                          .measure = meeting->measure, .distance = meeting->distance};
+            success = fwrite(&record, sizeof(record), 1, file) == 1;
+        }
+    }
+    return fclose(file) == 0 && success;
+}
+
+/**
+ * This function calculates the waiting people of all the shards (on shard 0): reads the cycles
+ * files into a spreader detector, calculates it with the rates the people were entered with
+ * (SpreaderDetectorCalculateEnteredRates), and writes the rates to the rates file
+ * (the cycles file of shard num_of_shards)
+ * @param num_of_shards the number of shards
+ * @param policy the scoring policy (NULL for SpreaderPolicyDefault)
+ * @param output_path the path to the output file
+ * @return true on success, false otherwise
+ */
+int CalculateWaiting(size_t num_of_shards, const SpreaderPolicy *policy, const char *output_path){
+    char path[MAX_LEN_OF_LINE + 32];
+    SpreaderDetector *spreader_detector = SpreaderDetectorAlloc();
+    int success = spreader_detector && SpreaderDetectorSetPolicy(spreader_detector, policy);
+    // all the people first - a meeting may be with a person of any shard
+    for (size_t i = 0; success && i < num_of_shards; ++i) {
+        GetShardCyclesPath(output_path, i, path, sizeof(path));
+        success = ReadWaiting(spreader_detector, path, false);
+    }
+    for (size_t i = 0; success && i < num_of_shards; ++i) {
+        GetShardCyclesPath(output_path, i, path, sizeof(path));
+        success = ReadWaiting(spreader_detector, path, true);
+    }
+    size_t size = success ? spreader_detector->people_size : 0;
+    double *entry_rates = malloc((size + 1)*sizeof(double));
+    double *rates = malloc((size + 1)*sizeof(double));
+    success = success && entry_rates && rates;
+    for (size_t i = 0; success && i < size; ++i) {
+        entry_rates[i] = spreader_detector->people[i]->infection_rate;
+    }
+    success = success && SpreaderDetectorCalculateEnteredRates(spreader_detector, entry_rates, rates);
+    FILE *file = NULL;
+    if (success){
+        GetShardCyclesPath(output_path, num_of_shards, path, sizeof(path));
+        file = fopen(path, "wb");
+        success = file != NULL;
+    }
+    for (size_t i = 0; success && i < size; ++i) {
+        ShardWaitingRate record = {.id = spreader_detector->people[i]->id, .rate = rates[i]};
+        success = fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+    if (file && fclose(file) != 0){
+        success = false;
+    }
+    free(entry_rates);
+    free(rates);
+    FreeShardDetector(&spreader_detector);
+    return success;
+}
+
+/**
+ * This function reads the people, or the meetings, of a cycles file into the spreader detector.
+ * The infection rate of a person is set to the rate he/she was entered with (-1 - not entered)
+ * @param spreader_detector the spreader detector (with the people of all the files for the meetings)
+ * @param path the path of the cycles file
+ * @param meetings false - reads the people, true - reads the meetings
+ * @return true on success, false otherwise
+ */
+int ReadWaiting(SpreaderDetector *spreader_detector, const char *path, int meetings){
+    FILE *file = fopen(path, "rb");
+    if (!file){
+        return false;
+    }
+    size_t waiting;
+    int success = fread(&waiting, sizeof(size_t), 1, file) == 1;
+    for (size_t i = 0; success && i < waiting; ++i) {
+        ShardWaitingPerson record;
+        success = fread(&record, sizeof(record), 1, file) == 1;
+        if (!success || meetings) continue;
+        Person *person = PersonAlloc(record.id, NULL, record.age, record.is_sick);
+        success = person && SpreaderDetectorAddPerson(spreader_detector, person);
+        if (!success){
+            if (person) PersonFree(&person);
+            break;
+        }
+        person->infection_rate = record.entered ? record.rate : -1;
+    }
+    ShardWaitingMeeting record;
+    while (success && meetings && fread(&record, sizeof(record), 1, file) == 1) {
+        Person *p1 = SpreaderDetectorGetPersonById(spreader_detector, record.id_1);
+        Person *p2 = SpreaderDetectorGetPersonById(spreader_detector, record.id_2);
+        Meeting *meeting = p1 && p2 ? MeetingAlloc(p1, p2, record.measure, record.distance) : NULL;
+        success = meeting && SpreaderDetectorAddMeeting(spreader_detector, meeting);
+        if (!success){
+            MeetingFree(&meeting);
+        }
+    }
+    success = success && !ferror(file);
+    fclose(file);
+    return success;
+}
+
+/**
+ * This function takes the rates shard 0 calculated for the waiting people of the shard
+ * @param worker the worker
+ * @param path the path of the rates file
+ * @return true on success, false otherwise
+ */
+int ApplyWaitingRates(ShardWorker *worker, const char *path){
+    FILE *file = fopen(path, "rb");
+    if (!file){
+        return false;
+    }
+    ShardWaitingRate record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        Person *person = SpreaderDetectorGetPersonById(worker->spreader_detector, record.id);
+        if (person && person->slot < worker->num_of_local && worker->states[person->slot] == SHARD_REACHED){
+            person->infection_rate = record.rate;
+            worker->states[person->slot] = SHARD_CALCULATED;
+        }
+    }
+    int success = !ferror(file);
+    fclose(file);
+    return success;
+}
+
+/**
+ * This function writes the report of the people of the shard (in the order of the people file)
+ * @param worker the worker
+ * @param policy the scoring policy (NULL for SpreaderPolicyDefault)
+ * @param path the path of the report of the shard
+ * @return true on success, false otherwise
+ */
+int WriteShardReport(ShardWorker *worker, const SpreaderPolicy *policy, const char *path){
+    FILE *file = fopen(path, "w");
+    if (!file){
+        return false;
+    }
+    policy = policy ? policy : SpreaderPolicyDefault();
+    for (size_t i = 0; i < worker->num_of_local; ++i) {
+        const Person *person = worker->spreader_detector->people[i];
+        fprintf(file, TREATMENT_MSG, SpreaderPolicyTreatment(policy, person->infection_rate),
+                person->name, person->id, person->age, person->infection_rate);
+    }
+    return fclose(file) == 0;
+}
+
+/**
+ * This function merges the reports of the shards into the output file, in the order of the
+ * people file (the next line of the shard of each person)
+ * @param people_path the path to the people file
+ * @param output_path the path to the output file
+ * @param num_of_shards the number of shards
+ * @return true on success, false otherwise
+ */
+int MergeReports(const char *people_path, const char *output_path, size_t num_of_shards){
+    FILE *reports[SPREADER_SHARDS_MAX_SHARDS] = {NULL};
+    char path[MAX_LEN_OF_LINE + 32];
+    InputStream *people = InputStreamOpen(people_path);
+    FILE *output = fopen(output_path, "w");
+    int success = people && output;
+    for (size_t i = 0; success && i < num_of_shards; ++i) {
+        GetShardReportPath(output_path, i, path, sizeof(path));
+        reports[i] = fopen(path, "r");
+        success = reports[i] != NULL;
+    }
+    char buffer[MAX_LEN_OF_LINE], line[SHARD_MAX_REPORT_LINE];
+    while (success && InputStreamGetLine(people, buffer, MAX_LEN_OF_LINE)) {
+        IdT id;
+        sscanf(buffer, "%*s %zu", &id);
+        success = fgets(line, SHARD_MAX_REPORT_LINE, reports[ShardOf(id, num_of_shards)]) &&
+                  fputs(line, output) != EOF;
+    }
+    success = success && !InputStreamHasError(people);
+    for (size_t i = 0; i < num_of_shards; ++i) {
+        if (reports[i]) fclose(reports[i]);
+    }
+    if (output && fclose(output) != 0){
+        success = false;
+    }
+    InputStreamClose(&people);
+    return success;
+}
+
+/**
+ * This function compares two reports byte by byte
+ * @param path_1 the path of the first report
+ * @param path_2 the path of the second report
+ * @return true if both were read and are the same, false otherwise
+ */
+int SameReports(const char *path_1, const char *path_2){
+    FILE *file_1 = fopen(path_1, "rb");
+    FILE *file_2 = fopen(path_2, "rb");
+    int same = file_1 && file_2;
+    while (same) {
+        int c = fgetc(file_1);
+        same = c == fgetc(file_2);
+        if (c == EOF) break;
+    }
+    same = same && !ferror(file_1) && !ferror(file_2);
+    if (file_1) fclose(file_1);
+    if (file_2) fclose(file_2);
+    return same;
+}
+
+/**
+ * This function returns the path of the report of a shard - <output_path>.<shard>
+ * @param output_path the path to the output file
+ * @param shard the shard
+ * @param path output - the path
+ * @param size the size of path
+ */
+void GetShardReportPath(const char *output_path, size_t shard, char *path, size_t size){
+    snprintf(path, size, "%s.%zu", output_path, shard);
+}
+
+/**
+ * This function returns the path of the cycles file of a shard - <output_path>.<shard>.cycles
+ * (shard num_of_shards - the rates shard 0 calculated)
+ * @param output_path the path to the output file
+ * @param shard the shard
+ * @param path output - the path
+ * @param size the size of path
+ */
+void GetShardCyclesPath(const char *output_path, size_t shard, char *path, size_t size){
+    snprintf(path, size, "%s.%zu.cycles", output_path, shard);
+}
+
+/**
+ * This function frees the people, the meetings and the spreader detector of the worker
+ * @param worker the worker
+ */
+void FreeShardWorker(ShardWorker *worker){
+    FreeShardDetector(&worker->spreader_detector);
+    free(worker->outbound);
+    free(worker->outbound_offsets);
+    free(worker->states);
+    free(worker->remaining);
+    free(worker->entered);
+    free(worker->stack);
+}
+
+/**
+ * This function frees the people, the meetings and the spreader detector itself
+ * @param p_spreader_detector pointer to the spreader detector (may point to NULL)
+ */
+void FreeShardDetector(SpreaderDetector **p_spreader_detector){
+    SpreaderDetector *spreader_detector = *p_spreader_detector;
+    if (!spreader_detector){
+        return;
+    }
+    for (size_t i = 0; i < spreader_detector->meeting_size; ++i) {
+        MeetingFree(&spreader_detector->meetings[i]);
+    }
+    for (size_t i = 0; i < spreader_detector->people_size; ++i) {
+        PersonFree(&spreader_detector->people[i]);
+    }
+    SpreaderDetectorFree(p_spreader_detector);
+}
@@ -0,0 +1,113 @@
+#ifndef SPREADERSHARDS_H
+#define SPREADERSHARDS_H
+
+#include "SpreaderDetector.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+/**
+ * ======================= sharded mode ========================
+ * The people are partitioned by the hash of their id between worker processes
+ * (standing in for nodes), and each worker owns a spreader detector with its people
+ * and the meetings its people were met in. A meeting between two shards is kept by
+ * the shard of person_2, with a ghost person standing for person_1; the shard of
+ * person_1 sends person_1 to it as a boundary message.
+ * The workers run bulk-synchronous rounds: advance the local people, send the boundary
+ * messages over shared-memory rings (one ring per pair of shards, sized to the meetings
+ * between them), wait for all the workers, and apply the received messages to the ghosts -
+ * until a round sends no message. The rounds run in two phases:
+ * - reach - the people the sick people reach are marked (a message - the person is reached).
+ * - rate - a person is calculated once all the reached people who met him/her are, and gets
+ *   the highest of their rates (a sick person keeps 1; a message - the final rate of the person).
+ * A person sends each message once, so the phases always end. The rates do not depend on the
+ * number of shards, and are the rates of SpreaderDetectorCalculateInfectionChances.
+ * The people the rate phase leaves waiting are on (or after) a cycle of meetings: each worker
+ * writes its waiting people and the meetings between them to <output_path>.<shard>.cycles, and
+ * shard 0 calculates all of them together with the cycle rule (SpreaderDetectorCalculateEnteredRates)
+ * and writes their rates back for the workers.
+ * The ids are assumed to be unique and the meetings to be between existing people.
+ * ==============================================================
+ */
+
+/**
+ * @def SPREADER_SHARDS_MAX_SHARDS
+ * the maximal number of shards.
+ */
+#define SPREADER_SHARDS_MAX_SHARDS 64UL
+
+/**
+ * @struct ShardMessage
+ * A person, sent to a shard where he/she met someone.
+ * @param id the id of the person.
+ * @param rate the final infection rate of the person (the rate phase only).
+ */
+typedef struct ShardMessage {
+  IdT id;
+  double rate;
+} ShardMessage;
+
+/**
+ * @struct ShardRing
+ * A single producer single consumer ring of boundary messages in shared memory.
+ * @param head the number of messages written (by the sending shard).
+ * @param tail the number of messages read (by the receiving shard).
+ * @param capacity the number of messages the ring holds.
+ * @param offset the index of the first message of the ring in the messages area.
+ */
+typedef struct ShardRing {
+  atomic_size_t head;
+  atomic_size_t tail;
+  size_t capacity;
+  size_t offset;
+} ShardRing;
+
+/**
+ * @struct SpreaderShardsStats
+ * The statistics of a sharded run.
+ * @param rounds the number of rounds (of both phases).
+ * @param messages the number of boundary messages sent.
+ * @param cross_meetings the number of meetings between two shards.
+ * @param cycle_people the number of people on (or after) a cycle of meetings, calculated by shard 0.
+ */
+typedef struct SpreaderShardsStats {
+  size_t rounds;
+  size_t messages;
+  size_t cross_meetings;
+  size_t cycle_people;
+} SpreaderShardsStats;
+
+/**
+ * Calculates the infection rates of the people in the given files with the given number of
+ * worker processes, and prints the recommendation for treatment of all the people to the given
+ * output path (in the order of the people file, as SpreaderDetectorPrintRecommendTreatmentToAll).
+ * Each worker also writes its part of the report to <output_path>.<shard>, and its people on a cycle
+ * to <output_path>.<shard>.cycles (removed after the merge).
+ * @param people_path the path to the people file (plain, gzip or zstd - see InputStream.h).
+ * @param meetings_path the path to the meetings file (plain, gzip or zstd).
+ * @param num_of_shards the number of worker processes (1 to SPREADER_SHARDS_MAX_SHARDS).
+ * @param policy the scoring policy (NULL for SpreaderPolicyDefault).
+ * @param output_path the path to the output file.
+ * @param stats output - the statistics of the run (may be NULL).
+ * @return 1 if the report was printed successfully, 0 otherwise.
+ * @if_fails returns 0 (a worker failed).
+ * @assumption you can not assume anything.
+ */
+int SpreaderShardsRun(const char *people_path, const char *meetings_path, size_t num_of_shards,
+                      const SpreaderPolicy *policy, const char *output_path, SpreaderShardsStats *stats);
+
+/**
+ * Checks a report of SpreaderShardsRun against the in-memory detector: calculates the people in
+ * the given files with SpreaderDetectorCalculateInfectionChances, prints the report to
+ * <output_path>.check (removed after the check) and compares it with the report in output_path.
+ * @param people_path the path to the people file (plain, gzip or zstd - see InputStream.h).
+ * @param meetings_path the path to the meetings file (plain, gzip or zstd).
+ * @param policy the scoring policy of the run (NULL for SpreaderPolicyDefault).
+ * @param output_path the path to the report of the run.
+ * @return 1 if the reports are the same, 0 otherwise.
+ * @if_fails returns 0 (the files could not be read, or out of memory).
+ * @assumption you can not assume anything.
+ */
+int SpreaderShardsCheck(const char *people_path, const char *meetings_path, const SpreaderPolicy *policy,
+                        const char *output_path);
+
+#endif //SPREADERSHARDS_H